@@ -1,5 +1,5 @@
 
-:: This file cleans up generated .exe files, compiles the tests, and also runs them
+:: This file cleans up generated .exe files, compiles the C and C++ tests, and also runs them
 :: This file is also licensed under the terms of the Apache-2.0 license.
 
 
@@ -23,3 +23,18 @@ IF EXIST tests.exe (
     DEL /F tests.exe
 )
 
+g++ -std=c++17 -Wall -Wextra -Werror -Wpedantic -o tests-cpp tests.cpp -I.
+
+IF %ERRORLEVEL% NEQ 0 (
+    echo C++ compilation failed.
+    exit /b %ERRORLEVEL%
+)
+
+@echo on
+tests-cpp.exe
+
+@echo off
+IF EXIST tests-cpp.exe (
+    DEL /F tests-cpp.exe
+)
+
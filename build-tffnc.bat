@@ -0,0 +1,12 @@
+
+:: This file compiles tffnc, the offline template to C code generator
+:: This file is also licensed under the terms of the Apache-2.0 license.
+
+
+@echo off
+gcc -Wall -Wextra -Werror -Wpedantic -o tffnc tffnc.c -I.
+
+IF %ERRORLEVEL% NEQ 0 (
+    echo Compilation failed.
+    exit /b %ERRORLEVEL%
+)
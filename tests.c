@@ -20,6 +20,7 @@
 #include <time.h>
 
 #define TFFN_IMPLEMENTATION
+#define TFFN_ENABLE_THREADS
 #include "tffn.h"
 
 
@@ -111,6 +112,18 @@ void string_builder_tests() {
         tffn_sb_free(sb);
     }
     
+    for (size_t cap = 1; cap < 2000; cap *= 2) {
+        TFFNStrBuilder* sb = tffn_sb_new(cap);
+        char* space = tffn_sb_reserve(sb, 5);
+        memcpy(space, "Hello", 5);
+        tffn_sb_commit(sb, 5);
+        tffn_sb_append_char(sb, '!');
+        char* str = tffn_sb_to_str(sb);
+        expect_equal_str("Hello!", str);
+        free(str);
+        tffn_sb_free(sb);
+    }
+
     for (size_t cap = 1; cap < 2000; cap *= 2) {
         TFFNStrBuilder* sb = tffn_sb_new(cap);
         tffn_sb_append_sized(sb, "Hello world!", 12);
@@ -125,6 +138,82 @@ void string_builder_tests() {
 }
 
 
+void expect_sb_f64(double num) {
+    // The output must read back as the exact same number
+    TFFNStrBuilder* sb = tffn_sb_new(1);
+    tffn_sb_append_f64(sb, num);
+    char* str = tffn_sb_to_str(sb);
+    if(strtod(str, NULL) != num || strlen(str) > 24) {
+        printf("f64 round trip failed for '%s' (%%.17g is '%.17g')\n", str, num);
+        fail();
+    }
+    free(str);
+    tffn_sb_free(sb);
+}
+
+void string_builder_number_tests() {
+    TFFNStrBuilder* sb = tffn_sb_new(1);
+
+    #define expect_sb(exp, code) do { tffn_sb_clear(sb); code; tffn_sb_append_char(sb, '\0'); \
+        expect_equal_str(exp, sb->buffer); } while(0)
+
+    expect_sb("0", tffn_sb_append_u64(sb, 0));
+    expect_sb("7", tffn_sb_append_u64(sb, 7));
+    expect_sb("10", tffn_sb_append_u64(sb, 10));
+    expect_sb("12345", tffn_sb_append_u64(sb, 12345));
+    expect_sb("18446744073709551615", tffn_sb_append_u64(sb, UINT64_MAX));
+    expect_sb("-1", tffn_sb_append_i64(sb, -1));
+    expect_sb("9223372036854775807", tffn_sb_append_i64(sb, INT64_MAX));
+    expect_sb("-9223372036854775808", tffn_sb_append_i64(sb, INT64_MIN));
+
+    expect_sb("00042", tffn_sb_append_u64_padded(sb, 42, 5, '0'));
+    expect_sb("-0042", tffn_sb_append_i64_padded(sb, -42, 5, '0'));
+    expect_sb("  -42", tffn_sb_append_i64_padded(sb, -42, 5, ' '));
+    expect_sb("123456", tffn_sb_append_i64_padded(sb, 123456, 3, ' '));
+
+    expect_sb("0", tffn_sb_append_hex(sb, 0));
+    expect_sb("ff", tffn_sb_append_hex(sb, 255));
+    expect_sb("ffffffffffffffff", tffn_sb_append_hex(sb, UINT64_MAX));
+    expect_sb("000000ff", tffn_sb_append_hex_padded(sb, 255, 8));
+
+    expect_sb("0", tffn_sb_append_f64(sb, 0.0));
+    expect_sb("-0", tffn_sb_append_f64(sb, -0.0));
+    expect_sb("1", tffn_sb_append_f64(sb, 1.0));
+    expect_sb("-2.5", tffn_sb_append_f64(sb, -2.5));
+    expect_sb("0.1", tffn_sb_append_f64(sb, 0.1));
+    expect_sb("0.3", tffn_sb_append_f64(sb, 0.3));
+    expect_sb("0.30000000000000004", tffn_sb_append_f64(sb, 0.1 + 0.2));
+    expect_sb("3.14159", tffn_sb_append_f64(sb, 3.14159));
+    expect_sb("0.00012", tffn_sb_append_f64(sb, 0.00012));
+    expect_sb("1e+300", tffn_sb_append_f64(sb, 1e300));
+    expect_sb("5e-324", tffn_sb_append_f64(sb, 5e-324));
+    expect_sb("1.5e+20", tffn_sb_append_f64(sb, 1.5e20));
+    expect_sb("1.7976931348623157e+308", tffn_sb_append_f64(sb, 1.7976931348623157e308));
+    expect_sb("nan", tffn_sb_append_f64(sb, 0.0 / 0.0));
+    expect_sb("inf", tffn_sb_append_f64(sb, 1e308 * 10));
+    expect_sb("-inf", tffn_sb_append_f64(sb, -1e308 * 10));
+
+    #undef expect_sb
+
+    double tricky[] = { 5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 123456789012345.6, 
+        0.1 + 0.7, 1.0 / 3.0, 2.0 / 3.0, 1e-5, 9.999999999999999e14, 4503599627370495.5 };
+    for (size_t i = 0; i < sizeof(tricky) / sizeof(tricky[0]); i++) {
+        expect_sb_f64(tricky[i]);
+        expect_sb_f64(-tricky[i]);
+    }
+    for (int i = 0; i < 100000; i++) {
+        uint64_t bits = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ (uint64_t) rand();
+        double num;
+        memcpy(&num, &bits, sizeof(num));
+        if(num != num) continue;
+        expect_sb_f64(num);
+        expect_sb_f64((double) (rand() % 100000) / 1000);
+    }
+
+    tffn_sb_free(sb);
+}
+
+
 int global_num = 0;
 
 void dyn_func_inc_num(TFFNStrBuilder* sb) {
@@ -226,6 +315,7 @@ void parser_invalid_tests() {
 
     expect_null(tffn_parser_parse(parser, "[unclosed"));
     expect_null(tffn_parser_parse(parser, "[nested][unclosed"));
+    expect_null(tffn_parser_parse(parser, "[nested]["));
 
     expect_null(tffn_parser_parse(parser, "[ignore!token]"));
     expect_null(tffn_parser_parse(parser, "[ignore!!token]"));
@@ -286,6 +376,1390 @@ void parser_edge_case_tests() {
 }
 
 
+void parser_bulk_define_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "old", "Old");
+
+    TFFNStaticActionDef static_defs[] = {
+        { "hello!!", 5, "Hello" },   // names dont need to be NULL terminated
+        { "world", 5, "World" },
+        { "old", 3, "Duplicate of a previous definition" },
+        { "hello", 5, "Duplicate inside the same array" },
+        { "", 0, "Empty name" },
+        { "null", 4, NULL },
+    };
+    TFFNDefineResult results[6];
+    expect_equal_int(2, tffn_parser_define_static_actions(parser, static_defs, 6, results));
+    expect_equal_int(TFFN_DEFINE_OK, results[0]);
+    expect_equal_int(TFFN_DEFINE_OK, results[1]);
+    expect_equal_int(TFFN_DEFINE_DUPLICATE, results[2]);
+    expect_equal_int(TFFN_DEFINE_DUPLICATE, results[3]);
+    expect_equal_int(TFFN_DEFINE_INVALID, results[4]);
+    expect_equal_int(TFFN_DEFINE_INVALID, results[5]);
+    if(!tffn_parser_okay(parser)) fail();
+
+    TFFNDynamicActionDef dynamic_defs[] = {
+        { "greet", 5, dyn_func_greet, TFFN_ACTION_VOLATILE },
+        { "world", 5, dyn_func_dup, TFFN_ACTION_VOLATILE },
+    };
+    expect_equal_int(1, tffn_parser_define_dynamic_actions(parser, dynamic_defs, 2, results));
+    expect_equal_int(TFFN_DEFINE_OK, results[0]);
+    expect_equal_int(TFFN_DEFINE_DUPLICATE, results[1]);
+
+    expect_equal_str("Hello World Old Hello, Dynamic World!", 
+        tffn_parser_parse(parser, "[hello] [world] [old] [greet]"));
+
+    // Single definitions still see the bulk defined actions
+    tffn_parser_define_static_action(parser, "world", "Static duplicate");
+    expect_equal_str("An action with 'world' name already exists!", tffn_parser_err_msg(parser));
+    tffn_parser_free(parser);
+
+    // Lots of actions to force the tables to grow
+    parser = tffn_parser_new();
+    const size_t count = 5000;
+    TFFNStaticActionDef* many_defs = (TFFNStaticActionDef*) malloc(count * sizeof(TFFNStaticActionDef));
+    char* names = (char*) malloc(count * 8);
+    for (size_t i = 0; i < count; i++) {
+        many_defs[i].act_text = names + i * 8;
+        many_defs[i].act_text_length = sprintf(names + i * 8, "k%zu", i);
+        many_defs[i].static_act = names + i * 8;
+    }
+    expect_equal_int(count, tffn_parser_define_static_actions(parser, many_defs, count, NULL));
+    expect_equal_str("k0 k2500 k4999", tffn_parser_parse(parser, "[k0] [k2500] [k4999]"));
+
+    // Single inserts still work after a bulk definition
+    tffn_parser_define_static_action(parser, "single", "Single");
+    expect_equal_str("Single k1", tffn_parser_parse(parser, "[single] [k1]"));
+
+    tffn_parser_free(parser);
+    free(many_defs);
+    free(names);
+}
+
+
+void parser_update_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "greeting", "Hello");
+    tffn_parser_define_static_action(parser, "name", "World");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+
+    expect_equal_str("Hello World!", tffn_parser_parse(parser, "[greeting] [name]!!"));
+    expect_equal_str("Hello Hello", tffn_parser_parse(parser, "[greeting] [greeting]"));
+    expect_equal_str("World Dynamic Part", tffn_parser_parse(parser, "[name] [dyn]"));
+
+    // Only the formats using 'greeting' should see the new value
+    tffn_parser_update_static_action(parser, "greeting", "Merhaba");
+    if(!tffn_parser_okay(parser)) fail();
+    expect_equal_str("Merhaba World!", tffn_parser_parse(parser, "[greeting] [name]!!"));
+    expect_equal_str("Merhaba Merhaba", tffn_parser_parse(parser, "[greeting] [greeting]"));
+    expect_equal_str("World Dynamic Part", tffn_parser_parse(parser, "[name] [dyn]"));
+
+    // Updating multiple times between parses
+    tffn_parser_update_static_action(parser, "name", "Dunya");
+    tffn_parser_update_static_action(parser, "name", "Earth");
+    expect_equal_str("Merhaba Earth!", tffn_parser_parse(parser, "[greeting] [name]!!"));
+    expect_equal_str("Earth Dynamic Part", tffn_parser_parse(parser, "[name] [dyn]"));
+
+    // Updating an action that doesnt exist defines it
+    tffn_parser_update_static_action(parser, "new", "New");
+    expect_equal_str("New Earth", tffn_parser_parse(parser, "[new] [name]"));
+
+    // Dynamic actions cant be updated
+    tffn_parser_update_static_action(parser, "dyn", "Not allowed");
+    expect_equal_str("Action 'dyn' is not a static action!", tffn_parser_err_msg(parser));
+    expect_equal_str("World Dynamic Part", tffn_parser_parse(parser, "World [dyn]"));
+
+    tffn_parser_free(parser);
+}
+
+
+int policy_calls = 0;
+void dyn_func_counted(TFFNStrBuilder* sb) {
+    tffn_sb_append_i64(sb, policy_calls++);
+}
+
+void parser_policy_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_dynamic_action_ex(parser, "pure", dyn_func_counted, TFFN_ACTION_PURE);
+
+    // Pure actions run only once, even across different formats
+    policy_calls = 7;
+    expect_equal_str("7 7", tffn_parser_parse(parser, "[pure] [pure]"));
+    expect_equal_str("7 7", tffn_parser_parse(parser, "[pure] [pure]"));
+    expect_equal_str("<7>", tffn_parser_parse(parser, "<[pure]>"));
+    expect_equal_int(8, policy_calls);
+    tffn_parser_free(parser);
+
+    parser = tffn_parser_new();
+    tffn_parser_define_dynamic_action_ex(parser, "epoch", dyn_func_counted, TFFN_ACTION_EPOCH);
+    tffn_parser_define_dynamic_action(parser, "volatile", dyn_func_counted);
+
+    // Epoch actions run once per epoch, volatile ones run every time
+    policy_calls = 0;
+    expect_equal_str("0 0 1", tffn_parser_parse(parser, "[epoch] [epoch] [volatile]"));
+    expect_equal_str("0 0 2", tffn_parser_parse(parser, "[epoch] [epoch] [volatile]"));
+    tffn_parser_bump_epoch(parser);
+    expect_equal_str("3 3 4", tffn_parser_parse(parser, "[epoch] [epoch] [volatile]"));
+    expect_equal_str("3", tffn_parser_parse(parser, "[epoch]"));
+
+    // Bulk definitions can also have policies
+    TFFNDynamicActionDef defs[] = {
+        { "bulk_pure", 9, dyn_func_counted, TFFN_ACTION_PURE },
+        { "bulk_volatile", 13, dyn_func_counted, TFFN_ACTION_VOLATILE },
+    };
+    expect_equal_int(2, tffn_parser_define_dynamic_actions(parser, defs, 2, NULL));
+    expect_equal_str("5 6 5 7", tffn_parser_parse(parser, "[bulk_pure] [bulk_volatile] [bulk_pure] [bulk_volatile]"));
+    tffn_parser_free(parser);
+}
+
+
+void param_func_pad(TFFNStrBuilder* sb, const TFFNArg* args, size_t arg_count) {
+    // [pad:width,text] pads text with dots from the left until it is at least width long
+    if(arg_count != 2) { tffn_sb_append_nterm(sb, "?"); return; }
+    int width = atoi(args[0].str);
+    for (int i = (int) args[1].length; i < width; i++) tffn_sb_append_char(sb, '.');
+    tffn_sb_append_sized(sb, args[1].str, args[1].length);
+}
+void param_func_count(TFFNStrBuilder* sb, const TFFNArg* args, size_t arg_count) {
+    (void) args;
+    tffn_sb_append_u64(sb, arg_count);
+}
+
+void parser_param_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_param_action(parser, "pad", param_func_pad);
+    tffn_parser_define_param_action(parser, "count", param_func_count);
+    tffn_parser_define_static_action(parser, "static", "Static");
+    tffn_parser_define_static_action(parser, "odd:name", "Colon");
+
+    expect_equal_str("...ab|abcdef", tffn_parser_parse(parser, "[pad:5,ab]|[pad:3,abcdef]"));
+    expect_equal_str("...ab|abcdef", tffn_parser_parse(parser, "[pad:5,ab]|[pad:3,abcdef]"));
+    expect_equal_str("0 1 1 3", tffn_parser_parse(parser, "[count] [count:] [count:a] [count:a,,b]"));
+    expect_equal_str("?", tffn_parser_parse(parser, "[pad]"));
+
+    // An action whose name contains ':' still wins over argument parsing
+    expect_equal_str("Colon", tffn_parser_parse(parser, "[odd:name]"));
+
+    expect_null(tffn_parser_parse(parser, "[static:arg]"));
+    expect_equal_str("INVALID FORMAT: 'static' action doesnt take any arguments", tffn_parser_err_msg(parser));
+    expect_null(tffn_parser_parse(parser, "[undefined:arg]"));
+    expect_null(tffn_parser_parse(parser, "[:arg]"));
+    expect_null(tffn_parser_parse(parser, "[pad:5,a!!b]"));
+
+    tffn_parser_free(parser);
+}
+
+
+void parser_render_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "hi", "Hi");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+
+    TFFNValue values[] = {
+        tffn_value_str("oziris78 and more", 8),
+        tffn_value_i64(-42),
+        tffn_value_f64(0.5),
+        tffn_value_i64(INT64_MIN),
+    };
+
+    expect_equal_str("Hi oziris78, you are -42 and 0.5!", 
+        tffn_parser_render(parser, "[hi] [$0], you are [$1] and [$2]!!", values, 4));
+    expect_equal_str("-9223372036854775808 -42 oziris78 Dynamic Part", 
+        tffn_parser_render(parser, "[$3] [$1] [$0] [dyn]", values, 4));
+    expect_equal_str("0", tffn_parser_render(parser, "[$0]", (TFFNValue[]) { tffn_value_i64(0) }, 1));
+
+    // The same compiled format can be rendered with different values
+    TFFNValue other[] = { tffn_value_str("x", 1), tffn_value_i64(1234567890123), tffn_value_f64(-2) };
+    expect_equal_str("Hi x, you are 1234567890123 and -2!", 
+        tffn_parser_render(parser, "[hi] [$0], you are [$1] and [$2]!!", other, 3));
+
+    // Not enough values
+    expect_null(tffn_parser_render(parser, "[$0] [$3]", values, 3));
+    expect_null(tffn_parser_parse(parser, "[$0]"));
+    expect_null(tffn_parser_parse(parser, "[$]"));
+    expect_null(tffn_parser_parse(parser, "[$a]"));
+
+    // Formats without slots dont need values
+    expect_equal_str("Hi", tffn_parser_render(parser, "[hi]", NULL, 0));
+
+    // An action named like a slot still wins
+    tffn_parser_define_static_action(parser, "$9", "Nine");
+    expect_equal_str("Nine", tffn_parser_parse(parser, "[$9]"));
+
+    tffn_parser_free(parser);
+}
+
+
+void parser_error_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "hi", "Hi");
+
+    // Invalid formats keep failing the same way when they come from the format cache
+    for (int i = 0; i < 3; i++) {
+        expect_null(tffn_parser_parse(parser, "abc [hi] [nope] def"));
+        expect_equal_int(false, tffn_parser_okay(parser));
+        expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+        expect_equal_int(9, tffn_parser_err(parser)->offset);
+        expect_equal_int(10, tffn_parser_err(parser)->span_offset);
+        expect_equal_int(4, tffn_parser_err(parser)->span_length);
+        expect_equal_str("INVALID FORMAT: 'nope' action was never defined to the parser", tffn_parser_err_msg(parser));
+    }
+
+    expect_null(tffn_parser_parse(parser, "[hi][[hi]]"));
+    expect_equal_int(TFFN_ERR_NESTED_BRACKET, tffn_parser_err(parser)->code);
+    expect_equal_int(5, tffn_parser_err(parser)->offset);
+    expect_null(tffn_parser_parse(parser, "abc!"));
+    expect_equal_int(TFFN_ERR_TRAILING_BANG, tffn_parser_err(parser)->code);
+    expect_equal_int(3, tffn_parser_err(parser)->offset);
+    expect_null(tffn_parser_parse(parser, "ab[hi"));
+    expect_equal_int(TFFN_ERR_UNCLOSED_BRACKET, tffn_parser_err(parser)->code);
+    expect_equal_int(2, tffn_parser_err(parser)->offset);
+    expect_null(tffn_parser_parse(parser, "[hi:x]"));
+    expect_equal_str("INVALID FORMAT: 'hi' action doesnt take any arguments", tffn_parser_err_msg(parser));
+
+    // A successful parse clears the error, and the format doesnt remember the older one
+    expect_equal_str("Hi", tffn_parser_parse(parser, "[hi]"));
+    expect_equal_int(true, tffn_parser_okay(parser));
+    expect_equal_str("Hi", tffn_parser_parse(parser, "[hi]"));
+    expect_equal_int(true, tffn_parser_okay(parser));
+    expect_equal_int(TFFN_OK, tffn_parser_err(parser)->code);
+    expect_equal_str("", tffn_parser_err_msg(parser));
+
+    // A parser that never failed has no error text at all
+    TFFNParser* fresh = tffn_parser_new();
+    expect_equal_str("", tffn_parser_err_msg(fresh));
+    tffn_parser_free(fresh);
+
+    // Defining the missing action makes the cached failure compile
+    tffn_parser_define_static_action(parser, "nope", "Yes");
+    expect_equal_str("abc Hi Yes def", tffn_parser_parse(parser, "abc [hi] [nope] def"));
+
+    // Messages are never truncated no matter how long the offending name is
+    char long_name[300];
+    memset(long_name, 'a', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+    tffn_parser_define_static_action(parser, long_name, "A");
+    tffn_parser_define_static_action(parser, long_name, "A");
+    expect_equal_int(TFFN_ERR_DUPLICATE_ACTION, tffn_parser_err(parser)->code);
+    char* msg = tffn_parser_err_msg(parser);
+    expect_equal_int(strlen("An action with '' name already exists!") + strlen(long_name), strlen(msg));
+    free(msg);
+
+    tffn_parser_free(parser);
+}
+
+void parser_validate_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "hi", "Hi");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+    tffn_parser_define_param_action(parser, "pad", param_func_pad);
+
+    // Validation has to agree with parsing, long formats make sure the 8 byte scan gets used
+    const char* formats[] = {
+        "plain text without anything special in it at all", "[hi]", "!!", "a!", "[hi", "hi]", "[[hi]]",
+        "[h!i]", "[nope]", "[hi:x]", "[pad:5,x]", "[$0]", "[$]", "!", "![!]!!", "[]",
+        "some long text before the action [dyn] and some long text after it too",
+        "some long text before a missing action [missing] and after it",
+        "some long text before an escape !! and a bracket that never closes [hi",
+        "0123456]", "01234567]", "012345678]", "0123456789abcdef[hi]0123456789abcdef!",
+    };
+
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        TFFNError err;
+        bool valid = tffn_parser_validate(parser, formats[i], strlen(formats[i]), &err);
+        char* res = tffn_parser_render(parser, formats[i], (TFFNValue[]) { tffn_value_i64(1) }, 1);
+
+        expect_equal_int(res != NULL, valid);
+        expect_equal_int(tffn_parser_err(parser)->code, err.code);
+        expect_equal_int(tffn_parser_err(parser)->offset, err.offset);
+        expect_equal_int(tffn_parser_err(parser)->span_offset, err.span_offset);
+        expect_equal_int(tffn_parser_err(parser)->span_length, err.span_length);
+    }
+
+    // Only the given length is checked and the format cache is never touched
+    size_t cached = parser->format_cache->entry_count;
+    expect_equal_int(true, tffn_parser_validate(parser, "[hi] [nope]", 4, NULL));
+    expect_equal_int(false, tffn_parser_validate(parser, "[hi] [nope]", 11, NULL));
+    expect_equal_int(true, tffn_parser_validate(parser, "", 0, NULL));
+    expect_equal_int(cached, parser->format_cache->entry_count);
+
+    tffn_parser_free(parser);
+}
+
+void parser_sized_tests() {
+    TFFNParser* parser = tffn_parser_new();
+
+    // Names, static texts and formats are all taken as slices of bigger buffers
+    const char* buffer = "greet=Hello there|name=oziris78|[greet], [name]!! and [nope] [upd] [dyn] [pad:3,7]";
+    tffn_parser_define_static_action_n(parser, buffer, 5, buffer + 6, 5);
+    tffn_parser_define_static_action_n(parser, buffer + 18, 4, buffer + 23, 8);
+    tffn_parser_define_dynamic_action_n(parser, "dynamic", 3, dyn_func_dynamic, TFFN_ACTION_VOLATILE);
+    tffn_parser_define_param_action_n(parser, "padding", 3, param_func_pad);
+    tffn_parser_update_static_action_n(parser, "updated", 3, "Up!", 2);
+    expect_equal_int(true, tffn_parser_okay(parser));
+
+    const char* format = buffer + 32;
+    expect_equal_str("Hello, oziris78!", tffn_parser_parse_n(parser, format, 17));
+    expect_equal_str("Hello", tffn_parser_parse_n(parser, format, 7));
+    expect_equal_str("Up Dynamic Part ..7", tffn_parser_parse_n(parser, format + 29, 21));
+
+    // Formats that only differ in length dont share a cache entry
+    expect_equal_str("Hello, oziris78", tffn_parser_parse_n(parser, format, 15));
+    expect_null(tffn_parser_parse_n(parser, format, 29));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    expect_equal_int(22, tffn_parser_err(parser)->offset);
+    expect_equal_str("INVALID FORMAT: 'nope' action was never defined to the parser", tffn_parser_err_msg(parser));
+
+    // Sized names are reported correctly too
+    tffn_parser_define_static_action_n(parser, "greeting", 5, "x", 1);
+    expect_equal_str("An action with 'greet' name already exists!", tffn_parser_err_msg(parser));
+    tffn_parser_update_static_action_n(parser, "dyn", 3, "x", 1);
+    expect_equal_str("Action 'dyn' is not a static action!", tffn_parser_err_msg(parser));
+
+    TFFNValue values[] = { tffn_value_i64(5) };
+    expect_equal_str("5", tffn_parser_render_n(parser, "[$0] and more", 4, values, 1));
+    expect_equal_str("", tffn_parser_parse_n(parser, NULL, 0));
+
+    tffn_parser_free(parser);
+}
+
+size_t longest_chain(__TFFNHashTable* ht) {
+    size_t longest = 0;
+    for (size_t i = 0; i < ht->table_size; i++) {
+        size_t length = 0;
+        for (__TFFNEntry* temp = ht->entries[i]; temp != NULL; temp = temp->next) length++;
+        if(length > longest) longest = length;
+    }
+    return longest;
+}
+
+void parser_hash_tests() {
+    // Reference vector of SipHash-1-3 with the key 00 01 .. 0F and an empty message
+    expect_equal_int(1, __tffn_siphash13("", 0, 0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL) == 0xABAC0158050FC4DCULL);
+
+    // "AR" and "BA" hash the same with the unkeyed hash, so every mix of them collides
+    char formats[32][9];
+    for (int i = 0; i < 32; i++) {
+        for (int j = 0; j < 4; j++) {
+            memcpy(formats[i] + j * 2, (i >> j) & 1 ? "AR" : "BA", 2);
+        }
+        formats[i][8] = '\0';
+    }
+
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_set_hash_mode(parser, TFFN_HASH_FAST);
+    for (int i = 0; i < 16; i++) {
+        expect_equal_str(formats[i], tffn_parser_parse(parser, formats[i]));
+    }
+    expect_equal_int(TFFN_HASH_KEYED, parser->format_cache->mode);
+    expect_equal_int(1, longest_chain(parser->format_cache) <= TFFN_MAX_CHAIN_LENGTH);
+    for (int i = 0; i < 16; i++) {
+        expect_equal_str(formats[i], tffn_parser_parse(parser, formats[i]));
+    }
+    tffn_parser_free(parser);
+
+    // Keyed tables stay short no matter how many formats there are
+    parser = tffn_parser_new();
+    char format[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(format, sizeof(format), "format %d", i);
+        expect_equal_str(format, tffn_parser_parse(parser, format));
+    }
+    expect_equal_int(1, longest_chain(parser->format_cache) <= TFFN_MAX_CHAIN_LENGTH);
+    expect_equal_int(5000, parser->format_cache->entry_count);
+
+    // Switching modes keeps everything that was cached
+    tffn_parser_set_hash_mode(parser, TFFN_HASH_FAST);
+    expect_equal_str("format 1234", tffn_parser_parse(parser, "format 1234"));
+    expect_equal_int(5000, parser->format_cache->entry_count);
+
+    // Children derive their keys from the base, every parser still gets keys of its own
+    TFFNParser* first = tffn_parser_new_child(parser);
+    TFFNParser* second = tffn_parser_new_child(parser);
+    expect_equal_int(1, first->format_cache->key[0] != second->format_cache->key[0]);
+    expect_equal_int(1, first->format_cache->key[0] != first->strings->key[0]);
+    expect_equal_int(1, first->seed[0] != parser->seed[0] && first->seed[0] != second->seed[0]);
+    expect_equal_str("format 1", tffn_parser_parse(first, "format 1"));
+    tffn_parser_free(second);
+    tffn_parser_free(first);
+    tffn_parser_free(parser);
+}
+
+void parser_l0_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "a", "A");
+    tffn_parser_define_static_action(parser, "b", "B");
+
+    // The same pointer with different contents is never mixed up
+    char buffer[] = "[a] and [a]";
+    expect_equal_str("A and A", tffn_parser_parse(parser, buffer));
+    buffer[1] = 'b';
+    expect_equal_str("B and A", tffn_parser_parse(parser, buffer));
+    buffer[3] = '\0';
+    expect_equal_str("B", tffn_parser_parse(parser, buffer));
+    expect_equal_str("B and A", tffn_parser_parse_n(parser, "[b] and [a]", 11));
+
+    // Updates, failures and retries work the same when the template comes from the L0 cache
+    const char* format = "[a] [c]";
+    for (int i = 0; i < 3; i++) {
+        expect_null(tffn_parser_parse(parser, format));
+        expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    }
+    tffn_parser_define_static_action(parser, "c", "C");
+    expect_equal_str("A C", tffn_parser_parse(parser, format));
+    tffn_parser_update_static_action(parser, "a", "a");
+    expect_equal_str("a C", tffn_parser_parse(parser, format));
+
+    // Immutable formats are found by their address alone, even if the promise gets broken
+    tffn_parser_set_immutable_formats(parser, true);
+    char immutable[] = "[a][b]";
+    expect_equal_str("aB", tffn_parser_parse(parser, immutable));
+    immutable[2] = '\0';
+    expect_equal_str("aB", tffn_parser_parse(parser, immutable));
+    expect_equal_str("a C", tffn_parser_parse(parser, format));
+
+    tffn_parser_free(parser);
+}
+
+void parser_view_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+    tffn_parser_define_static_action(parser, "w", "World");
+    tffn_parser_define_static_action(parser, "e", "");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+
+    // Static formats always give the same borrowed string
+    TFFNStrView view = tffn_parser_render_view(parser, "[h] [w]!!", 9, NULL, 0);
+    expect_equal_str("Hello World!", view.str);
+    expect_equal_int(12, view.length);
+    TFFNStrView again = tffn_parser_render_view(parser, "[h] [w]!!", 9, NULL, 0);
+    expect_equal_int(1, view.str == again.str);
+
+    view = tffn_parser_render_view(parser, "[e]", 3, NULL, 0);
+    expect_equal_str("", view.str);
+    expect_equal_int(0, view.length);
+
+    // Dynamic formats are borrowed from the parser until the next render
+    TFFNValue values[] = { tffn_value_i64(42) };
+    view = tffn_parser_render_view(parser, "[h] [dyn] [$0]", 14, values, 1);
+    expect_equal_str("Hello Dynamic Part 42", view.str);
+    expect_equal_int(21, view.length);
+
+    // Errors
+    view = tffn_parser_render_view(parser, "[nope]", 6, NULL, 0);
+    expect_null(view.str);
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    view = tffn_parser_render_view(parser, "[$0]", 4, NULL, 0);
+    expect_null(view.str);
+
+    // Updating a static action changes what the format renders to
+    tffn_parser_update_static_action(parser, "w", "TFFN");
+    expect_equal_str("Hello TFFN!", tffn_parser_render_view(parser, "[h] [w]!!", 9, NULL, 0).str);
+    expect_equal_str("Hello TFFN!", tffn_parser_parse(parser, "[h] [w]!!"));
+
+    tffn_parser_free(parser);
+}
+
+void parser_layer_tests() {
+    TFFNParser* base = tffn_parser_new();
+    tffn_parser_define_static_action(base, "h", "Hello");
+    tffn_parser_define_static_action(base, "w", "World");
+    tffn_parser_define_dynamic_action_ex(base, "epoch", dyn_func_counted, TFFN_ACTION_EPOCH);
+    tffn_parser_define_param_action(base, "pad", param_func_pad);
+
+    TFFNParser* first = tffn_parser_new_child(base);
+    TFFNParser* second = tffn_parser_new_child(base);
+    tffn_parser_define_static_action(first, "name", "First");
+    tffn_parser_define_static_action(second, "name", "Second");
+    expect_equal_int(true, tffn_parser_okay(second));
+
+    // Children see the actions of the base plus their own ones
+    expect_equal_str("Hello First", tffn_parser_parse(first, "[h] [name]"));
+    expect_equal_str("Hello Second", tffn_parser_parse(second, "[h] [name]"));
+    expect_equal_str("..ab", tffn_parser_parse(first, "[pad:4,ab]"));
+    expect_null(tffn_parser_parse(base, "[name]"));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(base)->code);
+    expect_equal_int(1, tffn_parser_validate(first, "[w] [name]", 10, NULL));
+
+    // Inherited names cant be defined again but they can be shadowed by updates
+    tffn_parser_define_static_action(first, "h", "Hi");
+    expect_equal_int(TFFN_ERR_DUPLICATE_ACTION, tffn_parser_err(first)->code);
+    tffn_parser_update_static_action(first, "h", "Hi");
+    expect_equal_str("Hi First", tffn_parser_parse(first, "[h] [name]"));
+    tffn_parser_update_static_action(first, "h", "Hey");
+    expect_equal_str("Hey First", tffn_parser_parse(first, "[h] [name]"));
+    tffn_parser_update_static_action(first, "h", "Hi");
+    expect_equal_str("Hi First", tffn_parser_parse(first, "[h] [name]"));
+    expect_equal_str("Hello Second", tffn_parser_parse(second, "[h] [name]"));
+    tffn_parser_update_static_action(first, "epoch", "x");
+    expect_equal_int(TFFN_ERR_NOT_STATIC_ACTION, tffn_parser_err(first)->code);
+
+    // Every child counts its own epochs
+    policy_calls = 0;
+    expect_equal_str("0 0", tffn_parser_parse(first, "[epoch] [epoch]"));
+    expect_equal_str("1", tffn_parser_parse(second, "[epoch]"));
+    tffn_parser_bump_epoch(first);
+    expect_equal_str("2", tffn_parser_parse(first, "[epoch]"));
+    expect_equal_str("1", tffn_parser_parse(second, "[epoch]"));
+
+    // The base is frozen while it has children
+    tffn_parser_define_static_action(base, "new", "x");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(base)->code);
+    expect_equal_str("Action 'new' cant be defined since the parser is frozen!", tffn_parser_err_msg(base));
+    tffn_parser_update_static_action(base, "h", "x");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(base)->code);
+    TFFNStaticActionDef defs[] = { { "a", 1, "A" } };
+    TFFNDefineResult results[1];
+    expect_equal_int(0, tffn_parser_define_static_actions(base, defs, 1, results));
+    expect_equal_int(TFFN_DEFINE_FROZEN, results[0]);
+    expect_equal_str("Hello World", tffn_parser_parse(base, "[h] [w]"));
+
+    // Children can be bases too and they keep their base alive
+    TFFNParser* grandchild = tffn_parser_new_child(first);
+    expect_equal_str("Hi First World", tffn_parser_parse(grandchild, "[h] [name] [w]"));
+    tffn_parser_free(first);
+    tffn_parser_free(base);
+    expect_equal_str("Hi First World", tffn_parser_parse(grandchild, "[h] [name] [w]"));
+    tffn_parser_free(grandchild);
+
+    // Once the last child is gone the base can be changed again
+    TFFNParser* parent = tffn_parser_new();
+    tffn_parser_free(tffn_parser_new_child(parent));
+    tffn_parser_define_static_action(parent, "a", "A");
+    expect_equal_str("A", tffn_parser_parse(parent, "[a]"));
+    tffn_parser_free(parent);
+
+    expect_equal_str("Second", tffn_parser_parse(second, "[name]"));
+    tffn_parser_free(second);
+}
+
+void parser_freeze_tests() {
+    // Lots of actions so the perfect hash has many buckets to place
+    enum { ACTION_COUNT = 5000 };
+    static char names[ACTION_COUNT][16];
+    static char texts[ACTION_COUNT][16];
+    TFFNStaticActionDef defs[ACTION_COUNT];
+    for (int i = 0; i < ACTION_COUNT; i++) {
+        snprintf(names[i], sizeof(names[i]), "act%d", i);
+        snprintf(texts[i], sizeof(texts[i]), "<%d>", i);
+        defs[i].act_text = names[i];
+        defs[i].act_text_length = strlen(names[i]);
+        defs[i].static_act = texts[i];
+    }
+
+    TFFNParser* parser = tffn_parser_new();
+    expect_equal_int(ACTION_COUNT, tffn_parser_define_static_actions(parser, defs, ACTION_COUNT, NULL));
+    tffn_parser_define_dynamic_action_ex(parser, "epoch", dyn_func_counted, TFFN_ACTION_EPOCH);
+    tffn_parser_define_param_action(parser, "pad", param_func_pad);
+    tffn_parser_freeze(parser);
+
+    // Every action gets its own slot
+    expect_equal_int(ACTION_COUNT + 2, parser->perfect_hash->slot_count);
+    char format[32], expected[32];
+    for (int i = 0; i < ACTION_COUNT; i++) {
+        snprintf(format, sizeof(format), "[act%d]", i);
+        snprintf(expected, sizeof(expected), "<%d>", i);
+        expect_equal_str(expected, tffn_parser_parse(parser, format));
+    }
+    policy_calls = 0;
+    expect_equal_str("0 ...ab", tffn_parser_parse(parser, "[epoch] [pad:5,ab]"));
+
+    // Missing names still fail
+    expect_null(tffn_parser_parse(parser, "[act5000]"));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    expect_null(tffn_parser_parse(parser, "[act]"));
+    expect_equal_int(0, tffn_parser_validate(parser, "[ep]", 4, NULL));
+
+    // Definitions are rejected for good, even after children come and go
+    tffn_parser_define_static_action(parser, "new", "x");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(parser)->code);
+    tffn_parser_update_static_action(parser, "act1", "x");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(parser)->code);
+    TFFNParser* child = tffn_parser_new_child(parser);
+    tffn_parser_free(child);
+    tffn_parser_define_static_action(parser, "new", "x");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(parser)->code);
+
+    // Frozen children still adopt the epoch actions of their base
+    child = tffn_parser_new_child(parser);
+    tffn_parser_define_static_action(child, "own", "Own");
+    tffn_parser_freeze(child);
+    expect_equal_str("Own <7> 1", tffn_parser_parse(child, "[own] [act7] [epoch]"));
+    expect_equal_str("1 1", tffn_parser_parse(child, "[epoch] [epoch]"));
+    tffn_parser_free(child);
+
+    // An empty parser can be frozen too
+    TFFNParser* empty = tffn_parser_new();
+    tffn_parser_freeze(empty);
+    expect_null(tffn_parser_parse(empty, "[x]"));
+    expect_equal_str("text", tffn_parser_parse(empty, "text"));
+    tffn_parser_free(empty);
+
+    tffn_parser_free(parser);
+}
+
+void parser_numa_tests() {
+    TFFNParser* base = tffn_parser_new();
+    tffn_parser_define_static_action(base, "h", "Hello");
+    tffn_parser_define_dynamic_action(base, "dyn", dyn_func_dynamic);
+    tffn_parser_define_dynamic_action_ex(base, "epoch", dyn_func_counted, TFFN_ACTION_EPOCH);
+    tffn_parser_enable_numa(base, 2); // simulated
+    tffn_parser_freeze(base);
+
+    // Every node gets its own copy of the frozen actions, made by its first child
+    TFFNParser* first = tffn_parser_new_child_on_node(base, 1);
+    expect_null(base->replicas[0]);
+    expect_equal_int(1, base->replicas[1] != NULL);
+    TFFNParser* second = tffn_parser_new_child_on_node(base, 1);
+    TFFNParser* other = tffn_parser_new_child_on_node(base, 0);
+    expect_equal_int(1, base->replicas[0] != NULL && base->replicas[0] != base->replicas[1]);
+
+    // Children of a node resolve to the actions of their own replica
+    __TFFNAction* action = tffn_parser_find_action(first, "dyn", 3);
+    expect_equal_int(1, action == tffn_parser_find_action(second, "dyn", 3));
+    expect_equal_int(1, action != tffn_parser_find_action(other, "dyn", 3));
+    expect_equal_int(1, action != tffn_parser_find_action(base, "dyn", 3));
+
+    expect_equal_str("Hello Dynamic Part", tffn_parser_parse(first, "[h] [dyn]"));
+    expect_equal_str("Hello Dynamic Part", tffn_parser_parse(other, "[h] [dyn]"));
+    policy_calls = 0;
+    expect_equal_str("0 0", tffn_parser_parse(first, "[epoch] [epoch]"));
+    expect_equal_str("1", tffn_parser_parse(second, "[epoch]"));
+    expect_null(tffn_parser_parse(other, "[nope]"));
+
+    // Without replication children read the frozen actions of the base directly
+    TFFNParser* plain = tffn_parser_new();
+    tffn_parser_define_dynamic_action(plain, "dyn", dyn_func_dynamic);
+    tffn_parser_freeze(plain);
+    TFFNParser* child = tffn_parser_new_child_on_node(plain, 1);
+    expect_equal_int(1, tffn_parser_find_action(child, "dyn", 3) == tffn_parser_find_action(plain, "dyn", 3));
+    tffn_parser_free(child);
+    tffn_parser_free(plain);
+
+    tffn_parser_free(first);
+    tffn_parser_free(second);
+    tffn_parser_free(other);
+    tffn_parser_free(base);
+}
+
+// Every thread keeps making children of a shared frozen base on its own node and compiles formats with them
+// They also keep creating and freeing children of a base that isnt frozen for good, that base has to be
+// frozen as long as any of them is alive, no matter how the threads interleave
+#define NUMA_THREAD_COUNT 8
+TFFNParser* numa_shared_base = NULL;
+TFFNParser* numa_layered_base = NULL;
+int numa_thread_failures[NUMA_THREAD_COUNT];
+
+#ifdef _WIN32
+DWORD WINAPI numa_child_worker(LPVOID arg) {
+#else
+void* numa_child_worker(void* arg) {
+#endif
+    size_t index = (size_t) (uintptr_t) arg;
+    for (int i = 0; i < 100; i++) {
+        TFFNParser* child = tffn_parser_new_child_on_node(numa_shared_base, index);
+        char* str = tffn_parser_parse(child, "[h] [dyn]!!");
+        if(str == NULL || strcmp(str, "Hello Dynamic Part!") != 0) numa_thread_failures[index]++;
+        free(str);
+        tffn_parser_free(child);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        TFFNParser* child = tffn_parser_new_child(numa_layered_base);
+        if(!__tffn_parser_frozen(numa_layered_base)) numa_thread_failures[index]++;
+        tffn_parser_free(child);
+    }
+    return 0;
+}
+
+void parser_numa_thread_tests() {
+    numa_shared_base = tffn_parser_new();
+    tffn_parser_define_static_action(numa_shared_base, "h", "Hello");
+    tffn_parser_define_dynamic_action(numa_shared_base, "dyn", dyn_func_dynamic);
+    tffn_parser_enable_numa(numa_shared_base, 4); // simulated, two threads per node
+    tffn_parser_freeze(numa_shared_base);
+    numa_layered_base = tffn_parser_new();
+    tffn_parser_define_static_action(numa_layered_base, "h", "Hello");
+
+#ifdef _WIN32
+    HANDLE threads[NUMA_THREAD_COUNT];
+    for (size_t i = 0; i < NUMA_THREAD_COUNT; i++) {
+        threads[i] = CreateThread(NULL, 0, numa_child_worker, (LPVOID) (uintptr_t) i, 0, NULL);
+    }
+    WaitForMultipleObjects(NUMA_THREAD_COUNT, threads, TRUE, INFINITE);
+    for (size_t i = 0; i < NUMA_THREAD_COUNT; i++) CloseHandle(threads[i]);
+#else
+    pthread_t threads[NUMA_THREAD_COUNT];
+    for (size_t i = 0; i < NUMA_THREAD_COUNT; i++) {
+        pthread_create(&threads[i], NULL, numa_child_worker, (void*) (uintptr_t) i);
+    }
+    for (size_t i = 0; i < NUMA_THREAD_COUNT; i++) pthread_join(threads[i], NULL);
+#endif
+
+    for (size_t i = 0; i < NUMA_THREAD_COUNT; i++) expect_equal_int(0, numa_thread_failures[i]);
+    for (size_t i = 0; i < 4; i++) expect_equal_int(1, numa_shared_base->replicas[i] != NULL);
+
+    // Every child is gone again so the base is back to a single reference
+    expect_equal_int(1, numa_shared_base->ref_count);
+    tffn_parser_free(numa_shared_base);
+
+    // Same for the layered base, which is frozen again as soon as it gets a child
+    expect_equal_int(1, numa_layered_base->ref_count);
+    expect_equal_int(0, __tffn_parser_frozen(numa_layered_base));
+    TFFNParser* held = tffn_parser_new_child(numa_layered_base);
+    expect_equal_int(1, __tffn_parser_frozen(numa_layered_base));
+    tffn_parser_define_static_action(numa_layered_base, "new", "New");
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(numa_layered_base)->code);
+
+    tffn_parser_free(held);
+    expect_equal_int(0, __tffn_parser_frozen(numa_layered_base));
+    tffn_parser_define_static_action(numa_layered_base, "new", "New");
+    expect_equal_int(true, tffn_parser_okay(numa_layered_base));
+    tffn_parser_free(numa_layered_base);
+}
+
+// Grandchildren compile formats on several threads while their mid layer adopts epoch actions
+// of the base, the mid layer is their base so the table they look names up in cant change
+#define LAYERED_THREAD_COUNT 4
+#define LAYERED_ACTION_COUNT 200
+TFFNParser* layered_mid = NULL;
+int layered_thread_failures[LAYERED_THREAD_COUNT];
+
+#ifdef _WIN32
+DWORD WINAPI layered_grandchild_worker(LPVOID arg) {
+#else
+void* layered_grandchild_worker(void* arg) {
+#endif
+    size_t index = (size_t) (uintptr_t) arg;
+    char format[32];
+    for (int i = 0; i < 50; i++) {
+        TFFNParser* grandchild = tffn_parser_new_child(layered_mid);
+        for (int j = 0; j < LAYERED_ACTION_COUNT; j += 10) {
+            snprintf(format, sizeof(format), "[h] [e%d]!!", (j + i) % LAYERED_ACTION_COUNT);
+            char* str = tffn_parser_parse(grandchild, format);
+            if(str == NULL || strcmp(str, "Hello Dynamic Part!") != 0) layered_thread_failures[index]++;
+            free(str);
+        }
+        tffn_parser_free(grandchild);
+    }
+    return 0;
+}
+
+void parser_layered_thread_tests() {
+    TFFNParser* base = tffn_parser_new();
+    tffn_parser_define_static_action(base, "h", "Hello");
+    tffn_parser_define_dynamic_action_ex(base, "epoch", dyn_func_dynamic, TFFN_ACTION_EPOCH);
+    char name[16];
+    for (int i = 0; i < LAYERED_ACTION_COUNT; i++) {
+        snprintf(name, sizeof(name), "e%d", i);
+        tffn_parser_define_dynamic_action_ex(base, name, dyn_func_dynamic, TFFN_ACTION_EPOCH);
+    }
+    layered_mid = tffn_parser_new_child(base);
+
+#ifdef _WIN32
+    HANDLE threads[LAYERED_THREAD_COUNT];
+    for (size_t i = 0; i < LAYERED_THREAD_COUNT; i++) {
+        threads[i] = CreateThread(NULL, 0, layered_grandchild_worker, (LPVOID) (uintptr_t) i, 0, NULL);
+    }
+#else
+    pthread_t threads[LAYERED_THREAD_COUNT];
+    for (size_t i = 0; i < LAYERED_THREAD_COUNT; i++) {
+        pthread_create(&threads[i], NULL, layered_grandchild_worker, (void*) (uintptr_t) i);
+    }
+#endif
+
+    // The mid layer adopts every action of the base meanwhile
+    char format[32];
+    int mid_failures = 0;
+    for (int i = 0; i < LAYERED_ACTION_COUNT; i++) {
+        char* str = tffn_parser_parse(layered_mid, "[epoch]");
+        if(str == NULL || strcmp(str, "Dynamic Part") != 0) mid_failures++;
+        free(str);
+        snprintf(format, sizeof(format), "[e%d]", i);
+        str = tffn_parser_parse(layered_mid, format);
+        if(str == NULL || strcmp(str, "Dynamic Part") != 0) mid_failures++;
+        free(str);
+    }
+
+#ifdef _WIN32
+    WaitForMultipleObjects(LAYERED_THREAD_COUNT, threads, TRUE, INFINITE);
+    for (size_t i = 0; i < LAYERED_THREAD_COUNT; i++) CloseHandle(threads[i]);
+#else
+    for (size_t i = 0; i < LAYERED_THREAD_COUNT; i++) pthread_join(threads[i], NULL);
+#endif
+
+    expect_equal_int(0, mid_failures);
+    for (size_t i = 0; i < LAYERED_THREAD_COUNT; i++) expect_equal_int(0, layered_thread_failures[i]);
+
+    // The adopted copies are the mid layer's own but its table of actions never changed
+    __TFFNAction* adopted = tffn_parser_find_action(layered_mid, "epoch", 5);
+    expect_equal_int(1, adopted != NULL && adopted != tffn_parser_find_action(base, "epoch", 5));
+    expect_equal_int(1, adopted == tffn_parser_find_action(layered_mid, "epoch", 5));
+    expect_equal_int(0, layered_mid->actions->entry_count);
+    expect_equal_int(LAYERED_ACTION_COUNT + 1, layered_mid->adopted->entry_count);
+
+    tffn_parser_free(layered_mid);
+    tffn_parser_free(base);
+}
+
+// A fake lookup that finishes once async_ready is set, its token is the address of async_request
+int async_request = 0;
+bool async_ready = false;
+TFFNAsyncStatus async_func_lookup(TFFNStrBuilder* sb, void** token) {
+    if(async_ready) {
+        tffn_sb_append_nterm(sb, "Fetched");
+        return TFFN_ASYNC_DONE;
+    }
+    if(token != NULL) *token = &async_request;
+    return TFFN_ASYNC_PENDING;
+}
+
+void parser_async_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+    tffn_parser_define_async_action(parser, "fetch", async_func_lookup);
+
+    // The render stops at the pending action and continues where it left off
+    async_ready = false;
+    TFFNValue values[] = { tffn_value_i64(5) };
+    TFFNAsyncRender* render = tffn_parser_render_async(parser, "[h] [fetch] [dyn] [$0]", 22, values, 1);
+    expect_equal_int(TFFN_RENDER_PENDING, tffn_async_status(render));
+    expect_equal_int(1, tffn_async_token(render) == &async_request);
+    expect_null(tffn_async_result(render).str);
+    expect_equal_int(TFFN_RENDER_PENDING, tffn_async_resume(render));
+
+    async_ready = true;
+    expect_equal_int(TFFN_RENDER_DONE, tffn_async_resume(render));
+    expect_null(tffn_async_token(render));
+    expect_equal_str("Hello Fetched Dynamic Part 5", tffn_async_result(render).str);
+    expect_equal_int(28, tffn_async_result(render).length);
+    tffn_async_free(render);
+
+    // Renders that dont have to wait are done right away
+    render = tffn_parser_render_async(parser, "[fetch]!!", 9, NULL, 0);
+    expect_equal_int(TFFN_RENDER_DONE, tffn_async_status(render));
+    expect_equal_str("Fetched!", tffn_async_result(render).str);
+    tffn_async_free(render);
+
+    // Synchronous renders cant wait
+    expect_equal_str("Hello Fetched", tffn_parser_parse(parser, "[h] [fetch]"));
+    async_ready = false;
+    expect_null(tffn_parser_parse(parser, "[h] [fetch]"));
+    expect_equal_int(TFFN_ERR_ACTION_PENDING, tffn_parser_err(parser)->code);
+    expect_equal_str("Action 'fetch' has to be waited for, use tffn_parser_render_async for it!", tffn_parser_err_msg(parser));
+
+    // Waiting renders keep the values that static actions had when they started
+    render = tffn_parser_render_async(parser, "[fetch] [h]", 11, NULL, 0);
+    tffn_parser_update_static_action(parser, "h", "Hi");
+    async_ready = true;
+    expect_equal_str("Fetched Hi", tffn_parser_parse(parser, "[fetch] [h]"));
+    expect_equal_int(TFFN_RENDER_DONE, tffn_async_resume(render));
+    expect_equal_str("Fetched Hello", tffn_async_result(render).str);
+    tffn_async_free(render);
+
+    // Errors
+    expect_null(tffn_parser_render_async(parser, "[nope]", 6, NULL, 0));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    expect_null(tffn_parser_render_async(parser, "[$1]", 4, values, 1));
+    expect_equal_int(TFFN_ERR_MISSING_VALUES, tffn_parser_err(parser)->code);
+
+    tffn_parser_free(parser);
+}
+
+void parser_parallel_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+    tffn_parser_define_dynamic_action(parser, "inc", dyn_func_inc_num);
+    tffn_parser_define_param_action(parser, "pad", param_func_pad);
+    tffn_parser_define_dynamic_action_ex(parser, "epoch", dyn_func_greet, TFFN_ACTION_EPOCH);
+    tffn_parser_set_parallel_action(parser, "dyn", true);
+    tffn_parser_set_parallel_action(parser, "pad", true);
+    tffn_parser_set_parallel_action(parser, "epoch", true); // ignored, epoch actions touch the parser
+    expect_equal_int(true, tffn_parser_okay(parser));
+
+    const char* fmt = "[h] [dyn] [inc] [pad:5,ab] [$0] [epoch] [dyn][pad:3,x] [inc]";
+    TFFNValue values[] = { tffn_value_i64(9) };
+    global_num = 0;
+    char* expected = tffn_parser_render(parser, fmt, values, 1);
+    expect_equal_str("Hello Dynamic Part 0 ...ab 9 Hello, Dynamic World! Dynamic Part..x 1", expected);
+
+    // Workers give the same output, actions that arent parallel still run in order on this thread
+    tffn_parser_set_worker_count(parser, 4);
+    for (int i = 0; i < 50; i++) {
+        global_num = 0;
+        expect_equal_str(expected, tffn_parser_render(parser, fmt, values, 1));
+    }
+    expect_equal_str("Dynamic Part", tffn_parser_parse(parser, "[dyn]"));
+
+    // Many parallel actions in one format
+    TFFNStrBuilder* many_fmt = tffn_sb_new(64);
+    TFFNStrBuilder* many_exp = tffn_sb_new(64);
+    for (int i = 0; i < 200; i++) {
+        tffn_sb_append_nterm(many_fmt, (i % 2 == 0) ? "[dyn]," : "[pad:4,z]");
+        tffn_sb_append_nterm(many_exp, (i % 2 == 0) ? "Dynamic Part," : "...z");
+    }
+    tffn_sb_append_char(many_fmt, '\0');
+    tffn_sb_append_char(many_exp, '\0');
+    expect_equal_str(many_exp->buffer, tffn_parser_parse(parser, many_fmt->buffer));
+    expect_equal_str(many_exp->buffer, tffn_parser_parse(parser, many_fmt->buffer));
+
+    // Errors
+    tffn_parser_set_parallel_action(parser, "nope", true);
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+
+    TFFNParser* child = tffn_parser_new_child(parser);
+    tffn_parser_set_parallel_action(parser, "inc", true);
+    expect_equal_int(TFFN_ERR_FROZEN_PARSER, tffn_parser_err(parser)->code);
+    tffn_parser_set_parallel_action(child, "dyn", false);
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(child)->code);
+    tffn_parser_free(child);
+
+    // Turning the workers off
+    tffn_parser_set_worker_count(parser, 0);
+    global_num = 0;
+    expect_equal_str(expected, tffn_parser_render(parser, fmt, values, 1));
+
+    free(expected);
+    tffn_sb_free(many_fmt);
+    tffn_sb_free(many_exp);
+    tffn_parser_free(parser);
+}
+
+void dyn_func_markup(TFFNStrBuilder* sb) { tffn_sb_append_nterm(sb, "<b>\"it's\"</b>"); }
+
+void parser_escape_tests() {
+    TFFNStrBuilder* sb = tffn_sb_new(4);
+    #define expect_escaped(exp, str, escape) do { tffn_sb_clear(sb); \
+        tffn_sb_append_escaped(sb, str, strlen(str), escape); tffn_sb_append_char(sb, '\0'); \
+        expect_equal_str(exp, sb->buffer); \
+        tffn_sb_clear(sb); tffn_sb_append_nterm(sb, "x"); tffn_sb_append_nterm(sb, str); \
+        tffn_sb_escape_tail(sb, 1, escape); tffn_sb_append_char(sb, '\0'); \
+        expect_equal_str(exp, sb->buffer + 1); } while(0)
+
+    expect_escaped("", "", TFFN_ESCAPE_HTML);
+    expect_escaped("plain text that is long enough", "plain text that is long enough", TFFN_ESCAPE_HTML);
+    expect_escaped("a &lt;b&gt; &amp; &quot;c&quot; &#39;d&#39;", "a <b> & \"c\" 'd'", TFFN_ESCAPE_HTML);
+    expect_escaped("<raw>", "<raw>", TFFN_ESCAPE_RAW);
+    expect_escaped("<default>", "<default>", TFFN_ESCAPE_DEFAULT);
+    expect_escaped("say \\\"hi\\\"\\n\\t\\\\ \\u0001 done", "say \"hi\"\n\t\\ \x01 done", TFFN_ESCAPE_JSON);
+    expect_escaped("caf\xc3\xa9 12345678", "caf\xc3\xa9 12345678", TFFN_ESCAPE_JSON);
+    expect_escaped("''", "", TFFN_ESCAPE_SHELL);
+    expect_escaped("'rm -rf $HOME; echo '\\''hi'\\'''", "rm -rf $HOME; echo 'hi'", TFFN_ESCAPE_SHELL);
+    #undef expect_escaped
+    tffn_sb_free(sb);
+
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "title", "Tom & Jerry");
+    tffn_parser_define_static_action(parser, "bold", "<b>");
+    tffn_parser_define_dynamic_action(parser, "markup", dyn_func_markup);
+    tffn_parser_define_dynamic_action_ex(parser, "pure", dyn_func_markup, TFFN_ACTION_PURE);
+
+    // Per action modes
+    expect_equal_str("Tom & Jerry <b>", tffn_parser_parse(parser, "[title] [bold]"));
+    tffn_parser_set_action_escape(parser, "title", TFFN_ESCAPE_HTML);
+    tffn_parser_set_action_escape(parser, "markup", TFFN_ESCAPE_JSON);
+    expect_equal_int(true, tffn_parser_okay(parser));
+    expect_equal_str("Tom &amp; Jerry <b>", tffn_parser_parse(parser, "[title] [bold]"));
+    expect_equal_str("<b>\\\"it's\\\"</b>", tffn_parser_parse(parser, "[markup]"));
+
+    // Per format modes, the literal text of the format isnt escaped and actions keep their own modes
+    const char* fmt = "<p>[bold][$0][markup] [pure]</p>";
+    TFFNValue values[] = { tffn_value_str("a<b", 3) };
+    expect_equal_str("<p><b>a<b<b>\\\"it's\\\"</b> <b>\"it's\"</b></p>", tffn_parser_render(parser, fmt, values, 1));
+    tffn_parser_set_format_escape(parser, fmt, strlen(fmt), TFFN_ESCAPE_HTML);
+    expect_equal_str("<p>&lt;b&gt;a&lt;b<b>\\\"it's\\\"</b> &lt;b&gt;&quot;it&#39;s&quot;&lt;/b&gt;</p>",
+        tffn_parser_render(parser, fmt, values, 1));
+    tffn_parser_set_action_escape(parser, "bold", TFFN_ESCAPE_RAW);
+    tffn_parser_set_action_escape(parser, "pure", TFFN_ESCAPE_SHELL);
+    expect_equal_str("<p><b>a&lt;b<b>\\\"it's\\\"</b> '<b>\"it'\\''s\"</b>'</p>", tffn_parser_render(parser, fmt, values, 1));
+
+    // Updating an escaped static action escapes the new value
+    tffn_parser_update_static_action(parser, "bold", "<i>");
+    tffn_parser_update_static_action(parser, "title", "A > B");
+    expect_equal_str("A &gt; B", tffn_parser_parse(parser, "[title]"));
+    expect_equal_str("<p><i>a&lt;b<b>\\\"it's\\\"</b> '<b>\"it'\\''s\"</b>'</p>", tffn_parser_render(parser, fmt, values, 1));
+
+    // Errors
+    tffn_parser_set_action_escape(parser, "nope", TFFN_ESCAPE_HTML);
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    tffn_parser_set_format_escape(parser, "[nope]", 6, TFFN_ESCAPE_HTML);
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+
+    tffn_parser_free(parser);
+}
+
+void parser_render_state_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "label", "cpu");
+    tffn_parser_define_dynamic_action(parser, "num", dyn_func_inc_num);
+
+    const char* fmt = "[label]: [num]% [$0] ([$1])";
+    TFFNRenderState* state = tffn_parser_new_render_state(parser, fmt, strlen(fmt));
+    expect_not_null(state);
+    expect_equal_str("", tffn_render_state_result(state).str);
+
+    size_t change_count;
+    const TFFNChange* changes;
+    TFFNValue values[] = { tffn_value_str("up", 2), tffn_value_i64(7) };
+
+    // The first update changes everything
+    global_num = 5;
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    expect_equal_str("cpu: 5% up (7)", tffn_render_state_result(state).str);
+    changes = tffn_render_state_changes(state, &change_count);
+    expect_equal_int(1, change_count);
+    expect_equal_int(0, changes[0].offset);
+    expect_equal_int(0, changes[0].old_length);
+    expect_equal_int(14, changes[0].new_length);
+
+    // Only the outputs that differ are reported, a longer output moves the rest of the result
+    global_num = 10;
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    expect_equal_str("cpu: 10% up (7)", tffn_render_state_result(state).str);
+    changes = tffn_render_state_changes(state, &change_count);
+    expect_equal_int(1, change_count);
+    expect_equal_int(5, changes[0].offset);
+    expect_equal_int(1, changes[0].old_length);
+    expect_equal_int(2, changes[0].new_length);
+
+    global_num = 10;
+    values[1] = tffn_value_i64(42);
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    expect_equal_str("cpu: 10% up (42)", tffn_render_state_result(state).str);
+    changes = tffn_render_state_changes(state, &change_count);
+    expect_equal_int(1, change_count);
+    expect_equal_int(13, changes[0].offset);
+    expect_equal_int(1, changes[0].old_length);
+    expect_equal_int(2, changes[0].new_length);
+
+    global_num = 10;
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    tffn_render_state_changes(state, &change_count);
+    expect_equal_int(0, change_count);
+
+    // Changes come in order, and applying them to the previous result gives the new one
+    global_num = 9;
+    values[0] = tffn_value_str("down", 4);
+    values[1] = tffn_value_i64(1);
+    char* previous = tffn_sb_to_str(state->sb);
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    changes = tffn_render_state_changes(state, &change_count);
+    expect_equal_int(3, change_count);
+    TFFNStrBuilder* patched = tffn_sb_new(8);
+    tffn_sb_append_nterm(patched, previous);
+    for (size_t i = 0; i < change_count; i++) {
+        TFFNStrBuilder* next = tffn_sb_new(8);
+        tffn_sb_append_sized(next, patched->buffer, changes[i].offset);
+        tffn_sb_append_sized(next, tffn_render_state_result(state).str + changes[i].offset, changes[i].new_length);
+        size_t rest = changes[i].offset + changes[i].old_length;
+        tffn_sb_append_sized(next, patched->buffer + rest, patched->count - rest);
+        tffn_sb_free(patched);
+        patched = next;
+    }
+    tffn_sb_append_char(patched, '\0');
+    expect_equal_str("cpu: 9% down (1)", patched->buffer);
+    expect_equal_str("cpu: 9% down (1)", tffn_render_state_result(state).str);
+    tffn_sb_free(patched);
+    free(previous);
+
+    // Updating a static action of the format changes the whole result
+    tffn_parser_update_static_action(parser, "label", "mem");
+    global_num = 9;
+    expect_equal_int(true, tffn_render_state_update(state, values, 2));
+    expect_equal_str("mem: 9% down (1)", tffn_render_state_result(state).str);
+    changes = tffn_render_state_changes(state, &change_count);
+    expect_equal_int(1, change_count);
+    expect_equal_int(16, changes[0].old_length);
+
+    // Errors
+    expect_equal_int(false, tffn_render_state_update(state, values, 1));
+    expect_equal_int(TFFN_ERR_MISSING_VALUES, tffn_parser_err(parser)->code);
+    expect_null(tffn_parser_new_render_state(parser, "[nope]", 6));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+
+    tffn_render_state_free(state);
+    tffn_parser_free(parser);
+}
+
+void parser_memory_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+
+    TFFNMemoryUsage before = tffn_parser_memory_usage(parser);
+    expect_equal_int(0, before.cache_keys);
+    expect_equal_int(0, before.steps);
+    expect_equal_int(sizeof(TFFNParser) + before.actions + before.lookup + before.cache_table
+        + before.cache_keys + before.steps + before.strings + before.scratch, before.total);
+
+    // A huge render makes the scratch builders grow
+    size_t big_length = 200000;
+    char* big = (char*) malloc(big_length + 6);
+    memset(big, 'x', big_length);
+    memcpy(big + big_length, "[dyn]", 6);
+    char* str = tffn_parser_parse(parser, big);
+    expect_equal_int(big_length + 12, strlen(str));
+    free(str);
+
+    TFFNMemoryUsage grown = tffn_parser_memory_usage(parser);
+    expect_equal_int(1, grown.scratch > 2 * big_length);
+    expect_equal_int(big_length + 6, grown.cache_keys);
+    expect_equal_int(1, grown.strings > big_length);
+
+    // Shrinking cuts the builders but keeps the compiled formats
+    TFFNRenderState* state = tffn_parser_new_render_state(parser, "[h] [dyn]", 9);
+    tffn_render_state_update(state, NULL, 0);
+    tffn_parser_shrink(parser, 1024);
+    TFFNMemoryUsage shrunk = tffn_parser_memory_usage(parser);
+    expect_equal_int(1, shrunk.scratch < 4096);
+    expect_equal_int(1, shrunk.steps > grown.steps); // only the render state format got added
+    expect_equal_int(1, shrunk.cache_keys > big_length);
+
+    str = tffn_parser_parse(parser, big);
+    expect_equal_int(big_length + 12, strlen(str));
+    free(str);
+    expect_equal_int(true, tffn_render_state_update(state, NULL, 0));
+    expect_equal_str("Hello Dynamic Part", tffn_render_state_result(state).str);
+    tffn_render_state_free(state);
+    free(big);
+
+    // Cached failures are forgotten, the last error stays readable
+    expect_null(tffn_parser_parse(parser, "ab [nope]"));
+    expect_null(tffn_parser_parse(parser, "[$0"));
+    expect_equal_int(2, parser->failure_count);
+    tffn_parser_shrink(parser, 0);
+    expect_equal_int(0, parser->failure_count);
+    expect_equal_int(TFFN_ERR_UNCLOSED_BRACKET, tffn_parser_err(parser)->code);
+    char* msg = tffn_parser_err_msg(parser);
+    expect_not_null(msg);
+    free(msg);
+
+    expect_null(tffn_parser_parse(parser, "ab [nope]"));
+    expect_equal_str("INVALID FORMAT: 'nope' action was never defined to the parser", tffn_parser_err_msg(parser));
+    expect_equal_str("Hello", tffn_parser_parse(parser, "[h]"));
+
+    tffn_parser_free(parser);
+}
+
+void parser_string_pool_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+
+    // Formats that compile to the same static text share it
+    TFFNStrView first = tffn_parser_render_view(parser, "[h] world", 9, NULL, 0);
+    TFFNStrView second = tffn_parser_render_view(parser, "Hello world", 11, NULL, 0);
+    expect_equal_str("Hello world", first.str);
+    expect_equal_int(1, first.str == second.str);
+    expect_equal_int(1, parser->strings->string_count);
+
+    char format[64];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(format, sizeof(format), "<header>[dyn]<footer> %d", i % 10);
+        char* str = tffn_parser_parse(parser, format);
+        expect_equal_int(1, strncmp(str, "<header>Dynamic Part<footer> ", 29) == 0);
+        free(str);
+    }
+    expect_equal_int(12, parser->strings->string_count); // "<header>" and 10 footers
+
+    // Updated static actions give their old text back
+    tffn_parser_update_static_action(parser, "h", "Selam");
+    expect_equal_str("Selam world", tffn_parser_render_view(parser, "[h] world", 9, NULL, 0).str);
+    expect_equal_str("Hello world", tffn_parser_render_view(parser, "Hello world", 11, NULL, 0).str);
+    expect_equal_int(13, parser->strings->string_count);
+    tffn_parser_update_static_action(parser, "h", "Hello");
+    tffn_parser_render_view(parser, "[h] world", 9, NULL, 0);
+    expect_equal_int(12, parser->strings->string_count);
+
+    // Long texts get slabs of their own, which are freed once nothing uses them
+    size_t long_length = TFFN_STRING_SLAB_SIZE;
+    char* long_text = (char*) malloc(long_length + 1);
+    memset(long_text, 'y', long_length);
+    long_text[long_length] = '\0';
+    size_t before = tffn_parser_memory_usage(parser).strings;
+    tffn_parser_update_static_action(parser, "long", long_text);
+    char* str = tffn_parser_parse(parser, "[long]!!");
+    expect_equal_int(long_length + 1, strlen(str));
+    free(str);
+    expect_equal_int(1, tffn_parser_memory_usage(parser).strings > before + long_length);
+    tffn_parser_update_static_action(parser, "long", "short");
+    expect_equal_str("short!", tffn_parser_render_view(parser, "[long]!!", 8, NULL, 0).str);
+    expect_equal_int(1, tffn_parser_memory_usage(parser).strings < before + long_length);
+    free(long_text);
+    tffn_parser_free(parser);
+
+    // Space of released strings is reused, a static action that keeps changing doesnt grow the pool
+    parser = tffn_parser_new();
+    free(tffn_parser_parse(parser, "stays alive the whole time"));
+    char value[200];
+    for (int round = 0; round < 2000; round++) {
+        int length = 20 + (round * 37) % 150;
+        memset(value, 'a' + round % 26, length);
+        value[length] = '\0';
+        tffn_parser_update_static_action(parser, "v", value);
+        for (int i = 0; i < 4; i++) {
+            snprintf(format, sizeof(format), "%d [v] %d", i, i);
+            char* result = tffn_parser_parse(parser, format);
+            expect_equal_int(length + 4, strlen(result));
+            free(result);
+        }
+    }
+    expect_equal_int(1, tffn_parser_memory_usage(parser).strings < 2 * TFFN_STRING_SLAB_SIZE);
+    tffn_parser_free(parser);
+
+    // Shrinking moves the strings of mostly empty slabs together and frees those slabs
+    parser = tffn_parser_new();
+    memset(value, 'L', 190);
+    value[190] = '\0';
+    tffn_parser_define_static_action(parser, "v", value);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(format, sizeof(format), "[v] %d", i);
+        free(tffn_parser_parse(parser, format));
+    }
+    TFFNStrView view = tffn_parser_render_view(parser, "[v] 10", 6, NULL, 0);
+    tffn_parser_update_static_action(parser, "v", "s");
+    for (int i = 0; i < 1000; i++) {
+        if(i % 10 == 0) continue; // these keep their long text until they are used again
+        snprintf(format, sizeof(format), "[v] %d", i);
+        free(tffn_parser_parse(parser, format));
+    }
+    before = tffn_parser_memory_usage(parser).strings;
+    tffn_parser_shrink(parser, 64);
+    expect_equal_int(1, tffn_parser_memory_usage(parser).strings < before * 3 / 4);
+    expect_equal_int(1000, parser->strings->string_count);
+    expect_equal_int(0, strncmp(view.str, value, 190)); // its text never moves
+    for (int i = 0; i < 1000; i++) {
+        snprintf(format, sizeof(format), "[v] %d", i);
+        char* result = tffn_parser_parse(parser, format);
+        expect_equal_int(1, result[0] == 's' && atoi(result + 2) == i);
+        free(result);
+    }
+    tffn_parser_free(parser);
+}
+
+void parser_cold_tests() {
+    // The codec gives back exactly what it got, long literal runs and overlapping matches included
+    size_t raw_length = 5000;
+    char* raw = (char*) malloc(raw_length);
+    char* back = (char*) malloc(raw_length);
+    for (size_t i = 0; i < raw_length; i++) raw[i] = (i < 1000) ? (char) ((i * 7919) % 251) : (i < 3000 ? 'a' : "abcde"[i % 5]);
+    char* packed = (char*) malloc(__tffn_lz_bound(raw_length));
+    size_t packed_length = __tffn_lz_compress(raw, raw_length, packed);
+    expect_equal_int(1, packed_length < raw_length);
+    __tffn_lz_decompress(packed, packed_length, back);
+    expect_equal_int(0, memcmp(raw, back, raw_length));
+    free(raw);
+    free(back);
+    free(packed);
+
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+    tffn_parser_define_static_action(parser, "h", "Hello");
+
+    TFFNStrBuilder* text = tffn_sb_new(64);
+    for (int i = 0; i < 40; i++) tffn_sb_append_nterm(text, "lorem ipsum dolor sit amet ");
+    tffn_sb_append_char(text, '\0');
+
+    char hot_fmt[2048], cold_fmt[2048], tiny_fmt[] = "tiny [dyn]";
+    snprintf(hot_fmt, sizeof(hot_fmt), "hot %s[dyn]", text->buffer);
+    snprintf(cold_fmt, sizeof(cold_fmt), "[h] cold %s[dyn] end", text->buffer);
+    char* cold_expected = tffn_parser_parse(parser, cold_fmt);
+    free(tffn_parser_parse(parser, tiny_fmt));
+    for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, hot_fmt));
+
+    // Only formats that werent used lately and have enough static text get compressed
+    TFFNMemoryUsage before = tffn_parser_memory_usage(parser);
+    expect_equal_int(3, before.hot_formats);
+    expect_equal_int(1, tffn_parser_compress_cold(parser, 5));
+    TFFNMemoryUsage after = tffn_parser_memory_usage(parser);
+    expect_equal_int(2, after.hot_formats);
+    expect_equal_int(1, after.cold_formats);
+    expect_equal_int(1, after.cold > 0 && after.cold < text->count / 2);
+    expect_equal_int(0, tffn_parser_compress_cold(parser, 5));
+
+    // Using a cold format brings it back
+    expect_equal_str(cold_expected, tffn_parser_parse(parser, cold_fmt));
+    expect_equal_int(0, tffn_parser_memory_usage(parser).cold_formats);
+    expect_equal_int(0, tffn_parser_compress_cold(parser, 5));
+
+    // Cold formats still notice updated static actions
+    for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, hot_fmt));
+    expect_equal_int(1, tffn_parser_compress_cold(parser, 5));
+    tffn_parser_update_static_action(parser, "h", "Bye");
+    char* str = tffn_parser_parse(parser, cold_fmt);
+    expect_equal_int(0, strncmp(str, "Bye cold lorem", 14));
+    expect_equal_int(strlen(cold_expected) - 2, strlen(str));
+    free(str);
+
+    // Text that other formats share stays in the pool, so it isnt worth compressing
+    char shared_fmt[2048];
+    snprintf(shared_fmt, sizeof(shared_fmt), "hot %s[dyn]!!", text->buffer);
+    free(tffn_parser_parse(parser, shared_fmt));
+    for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, tiny_fmt));
+    expect_equal_int(1, tffn_parser_compress_cold(parser, 5)); // cold_fmt, hot_fmt shares its text with shared_fmt
+    expect_equal_int(1, tffn_parser_memory_usage(parser).cold_formats);
+
+    // Pinned and held formats stay hot
+    free(tffn_parser_parse(parser, cold_fmt));
+    TFFNAsyncRender* render = tffn_parser_render_async(parser, cold_fmt, strlen(cold_fmt), NULL, 0);
+    TFFNRenderState* state = tffn_parser_new_render_state(parser, hot_fmt, strlen(hot_fmt));
+    for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, tiny_fmt));
+    expect_equal_int(0, tffn_parser_compress_cold(parser, 5));
+    tffn_render_state_free(state);
+    tffn_async_free(render);
+
+    // So are formats that views point into, no matter how big their text is
+    size_t view_length = TFFN_STRING_SLAB_SIZE + 100;
+    char* view_fmt = (char*) malloc(view_length + 1);
+    memset(view_fmt, 'v', view_length);
+    view_fmt[view_length] = '\0';
+    TFFNStrView view = tffn_parser_render_view(parser, view_fmt, view_length, NULL, 0);
+    for (int i = 0; i < 20; i++) free(tffn_parser_parse(parser, tiny_fmt));
+    tffn_parser_compress_cold(parser, 5);
+    expect_equal_int(1, view.str[0] == 'v' && view.str[view_length - 1] == 'v');
+    expect_equal_int(view_length, view.length);
+    free(view_fmt);
+
+    free(cold_expected);
+    tffn_parser_free(parser);
+
+    // Compressing gives the memory of the released text back, thawing and compressing again doesnt grow the pool
+    parser = tffn_parser_new();
+    tffn_parser_define_dynamic_action(parser, "dyn", dyn_func_dynamic);
+    char formats[50][1200];
+    for (int i = 0; i < 50; i++) {
+        snprintf(formats[i], sizeof(formats[i]), "%d %.1000s[dyn] %d", i, text->buffer, i);
+        free(tffn_parser_parse(parser, formats[i]));
+        free(tffn_parser_parse(parser, tiny_fmt)); // hot text between the cold ones
+    }
+    for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, tiny_fmt));
+    before = tffn_parser_memory_usage(parser);
+    expect_equal_int(50, tffn_parser_compress_cold(parser, 5));
+    after = tffn_parser_memory_usage(parser);
+    expect_equal_int(1, after.total < before.total);
+    expect_equal_int(1, after.strings < before.strings / 2);
+
+    size_t thawed = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 50; i++) {
+            char* result = tffn_parser_parse(parser, formats[i]);
+            expect_equal_int(1, atoi(result) == i && strstr(result, "Dynamic Part") != NULL);
+            free(result);
+        }
+        if(round == 0) thawed = tffn_parser_memory_usage(parser).strings;
+        expect_equal_int(1, thawed < before.strings + TFFN_STRING_SLAB_SIZE / 2);
+        expect_equal_int(1, tffn_parser_memory_usage(parser).strings <= thawed);
+        for (int i = 0; i < 10; i++) free(tffn_parser_parse(parser, tiny_fmt));
+        expect_equal_int(50, tffn_parser_compress_cold(parser, 5));
+        expect_equal_int(1, tffn_parser_memory_usage(parser).total <= after.total);
+    }
+
+    tffn_sb_free(text);
+    tffn_parser_free(parser);
+}
+
 void parser_tests() {
     char* str = NULL;
     TFFNParser* parser = tffn_parser_new();
@@ -319,10 +1793,34 @@ int main() {
     printf("Running tests...\n");
 
     string_builder_tests();
+    string_builder_number_tests();
     parser_tests();
     parser_valid_tests();
     parser_invalid_tests();
     parser_edge_case_tests();
+    parser_bulk_define_tests();
+    parser_update_tests();
+    parser_policy_tests();
+    parser_param_tests();
+    parser_render_tests();
+    parser_error_tests();
+    parser_validate_tests();
+    parser_sized_tests();
+    parser_hash_tests();
+    parser_l0_tests();
+    parser_view_tests();
+    parser_layer_tests();
+    parser_freeze_tests();
+    parser_numa_tests();
+    parser_numa_thread_tests();
+    parser_layered_thread_tests();
+    parser_async_tests();
+    parser_parallel_tests();
+    parser_escape_tests();
+    parser_render_state_tests();
+    parser_memory_tests();
+    parser_string_pool_tests();
+    parser_cold_tests();
 
     printf("ALL TESTS PASSES!!!!\n");
     return 0;
@@ -0,0 +1,178 @@
+// Copyright 2024 Oğuzhan Topaloğlu
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ------------------------------------------------------------ //
+
+
+#include <stdio.h>
+#include <string.h>
+
+#define TFFN_IMPLEMENTATION
+#include "tffn.hpp"
+
+
+#define expect_equal_int(exp, act) expect_equal_int_inner((intmax_t)(exp), (intmax_t)(act), __FILE__, __LINE__)
+#define expect_equal_str(exp, act) expect_equal_str_inner((const char*)(exp), (const char*)(act), __FILE__, __LINE__)
+#define expect_null(act) expect_null_inner((void*)(act), __FILE__, __LINE__)
+
+
+void expect_null_inner(void* ptr, const char* file, int line) {
+    if(ptr == NULL) return;
+    printf("\n---------------------------\n");
+    printf("TEST FAILS!\nPlace: '%s:%d'\nExpected NULL but got: '%p'\n", file, line, ptr);
+    printf("---------------------------\n");
+    exit(78);
+}
+
+void expect_equal_int_inner(intmax_t exp, intmax_t act, const char* file, int line) {
+    if(exp == act) return;
+    printf("\n---------------------------\n");
+    printf("TEST FAILS!\nPlace: '%s:%d'\nExpected: '%jd'\nReceived: '%jd'\n", file, line, exp, act);
+    printf("---------------------------\n");
+    exit(78);
+}
+
+void expect_equal_str_inner(const char* exp, const char* act, const char* file, int line) {
+    if(exp == NULL && act == NULL) return;
+    if(exp != NULL && act != NULL && strcmp(exp, act) == 0) return;
+    printf("\n---------------------------\n");
+    printf("TEST FAILS!\nPlace: '%s:%d'\nExpected: '%s'\nReceived: '%s'\n", file, line, exp, act);
+    printf("---------------------------\n");
+    exit(78);
+}
+
+
+// ------------------------------------------------------------ //
+
+
+int global_num = 0;
+void dyn_func_inc_num(TFFNStrBuilder* sb) { tffn_sb_append_i64(sb, global_num++); }
+
+void param_func_join(TFFNStrBuilder* sb, const TFFNArg* args, size_t arg_count) {
+    for (size_t i = 0; i < arg_count; i++) {
+        if(i != 0) tffn_sb_append_char(sb, '+');
+        tffn_sb_append_sized(sb, args[i].str, args[i].length);
+    }
+}
+
+
+TFFNAsyncStatus async_func_never(TFFNStrBuilder* sb, void** token) {
+    (void) sb; (void) token;
+    return TFFN_ASYNC_PENDING;
+}
+
+
+void compiled_format_tests() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_update_static_action(parser, "hi", "Hi");
+    tffn_parser_define_dynamic_action_ex(parser, "inc", dyn_func_inc_num, TFFN_ACTION_VOLATILE);
+    tffn_parser_define_param_action(parser, "join", param_func_join);
+
+    // Everything is split at compile time
+    constexpr auto plain = TFFN_FORMAT("just [hi], [inc] and !! and ![!]");
+    static_assert(plain.step_count == 5, "");
+    expect_equal_str("just Hi, 0 and ! and []", plain.render(parser));
+    expect_equal_str("just Hi, 1 and ! and []", plain.render(parser));
+
+    constexpr auto empty = TFFN_FORMAT("");
+    static_assert(empty.step_count == 0, "");
+    expect_equal_str("", empty.render(parser));
+
+    // Arguments and slots
+    TFFNValue values[] = { tffn_value_str("x", 1), tffn_value_i64(-7) };
+    expect_equal_str("a+b+ and x -7 x", TFFN_FORMAT("[join:a,b,] and [$0] [$1] [$0]").render(parser, values, 2));
+    expect_equal_str("", TFFN_FORMAT("[join]").render(parser));
+
+    // The results match tffn_parser_render
+    const char* text = "[hi] [join:1,2] [$1]!!!!";
+    expect_equal_str(tffn_parser_render(parser, text, values, 2),
+        TFFN_FORMAT("[hi] [join:1,2] [$1]!!!!").render(parser, values, 2));
+
+    // Updated static actions are seen without rebinding
+    constexpr auto greet = TFFN_FORMAT("[hi]");
+    expect_equal_str("Hi", greet.render(parser));
+    tffn_parser_update_static_action(parser, "hi", "Hello");
+    expect_equal_str("Hello", greet.render(parser));
+
+    // Binding errors are reported like tffn.h reports them
+    constexpr auto missing = TFFN_FORMAT("ab [later]");
+    expect_null(missing.render(parser));
+    expect_equal_int(TFFN_ERR_UNDEFINED_ACTION, tffn_parser_err(parser)->code);
+    expect_equal_int(3, tffn_parser_err(parser)->offset);
+    expect_equal_str("INVALID FORMAT: 'later' action was never defined to the parser", tffn_parser_err_msg(parser));
+
+    expect_null(TFFN_FORMAT("[hi:x]").render(parser));
+    expect_equal_str("INVALID FORMAT: 'hi' action doesnt take any arguments", tffn_parser_err_msg(parser));
+
+    expect_null(TFFN_FORMAT("[$2]").render(parser, values, 2));
+    expect_equal_int(TFFN_ERR_MISSING_VALUES, tffn_parser_err(parser)->code);
+
+    // Defining the missing action rebinds the format
+    tffn_parser_update_static_action(parser, "later", "now");
+    expect_equal_str("ab now", missing.render(parser));
+    expect_equal_int(true, tffn_parser_okay(parser));
+
+    // Binding to another parser
+    TFFNParser* other = tffn_parser_new();
+    tffn_parser_update_static_action(other, "hi", "Selam");
+    expect_equal_str("Selam", greet.render(other));
+    expect_equal_str("Hello", greet.render(parser));
+    tffn_parser_free(other);
+
+    // A parser created after another one got freed never reuses its binding, even at the same address
+    constexpr auto reborn = TFFN_FORMAT("<[hi]>");
+    for (int i = 0; i < 4; i++) {
+        TFFNParser* first = tffn_parser_new();
+        tffn_parser_define_static_action(first, "hi", "First");
+        expect_equal_str("<First>", reborn.render(first));
+        uint64_t first_id = first->id;
+        tffn_parser_free(first);
+
+        void* reused = malloc(sizeof(__TFFNAction)); // likely takes the place of the freed action
+        memset(reused, 0xFF, sizeof(__TFFNAction));
+        TFFNParser* second = tffn_parser_new();
+        expect_equal_int(true, second->id != first_id);
+        tffn_parser_define_static_action(second, "hi", "Second");
+        expect_equal_str("<Second>", reborn.render(second));
+        tffn_parser_free(second);
+        free(reused);
+    }
+
+    // Escaping modes of actions are used too
+    tffn_parser_update_static_action(parser, "tag", "<a>");
+    tffn_parser_set_action_escape(parser, "tag", TFFN_ESCAPE_HTML);
+    expect_equal_str("&lt;a&gt; <", TFFN_FORMAT("[tag] <").render(parser));
+
+    // Asynchronous actions that cant finish make the render fail without appending anything
+    tffn_parser_define_async_action(parser, "wait", async_func_never);
+    TFFNStrBuilder* sb = tffn_sb_new(8);
+    tffn_sb_append_nterm(sb, "kept");
+    expect_equal_int(false, TFFN_FORMAT("[hi] [wait]").render_into(parser, sb));
+    expect_equal_int(TFFN_ERR_ACTION_PENDING, tffn_parser_err(parser)->code);
+    expect_equal_int(4, sb->count);
+    tffn_sb_free(sb);
+
+    tffn_parser_free(parser);
+}
+
+
+
+int main() {
+    printf("Running C++ tests...\n");
+
+    compiled_format_tests();
+
+    printf("ALL TESTS PASSES!!!!\n");
+    return 0;
+}
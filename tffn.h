@@ -72,9 +72,7 @@ void dyn_func_inc_num(TFFNStrBuilder* sb) {
     f1 = f2;
     f2 = f3;
 
-    char str[5];
-    sprintf(str, "%d", f3);
-    tffn_sb_append_nterm(sb, str);
+    tffn_sb_append_i64(sb, f3);
 }
 
 int main() {
@@ -162,12 +160,55 @@ with TFFN in the first place).
     #define TFFN_FREE(x) free((x))
 #endif
 
+// Maximum amount of invalid formats that are remembered by a single parser, parsing one of them
+// again only costs a single lookup, invalid formats after this limit are not remembered
+#ifndef TFFN_MAX_CACHED_FAILURES
+    #define TFFN_MAX_CACHED_FAILURES 1024
+#endif
+
+// Cold formats that have less static text of their own than this are never compressed, see tffn_parser_compress_cold
+#ifndef TFFN_MIN_COLD_BYTES
+    #define TFFN_MIN_COLD_BYTES 256
+#endif
+
+// Size of the memory blocks that the static text of compiled formats is interned into, longer
+// texts get a block of their own, see __TFFNStringPool
+#ifndef TFFN_STRING_SLAB_SIZE
+    #define TFFN_STRING_SLAB_SIZE (64 * 1024)
+#endif
+
+// Amount of slots in the pointer keyed cache that sits in front of the format cache, must be a power of two
+#ifndef TFFN_L0_CACHE_SIZE
+    #define TFFN_L0_CACHE_SIZE 64
+#endif
+
+// Longest bucket chain the format cache accepts before it changes its hash key or grows
+#ifndef TFFN_MAX_CHAIN_LENGTH
+    #define TFFN_MAX_CHAIN_LENGTH 8
+#endif
+
+// Least amount of parallel actions a format needs before its render uses the worker pool,
+// see tffn_parser_set_worker_count
+#ifndef TFFN_MIN_PARALLEL_STEPS
+    #define TFFN_MIN_PARALLEL_STEPS 2
+#endif
+
+// Most NUMA nodes that get their own replica of frozen actions, see tffn_parser_enable_numa
+#ifndef TFFN_MAX_NUMA_NODES
+    #define TFFN_MAX_NUMA_NODES 8
+#endif
+
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#ifdef __cplusplus
+extern "C" {  // prevents name mangling of functions when used in C++
+#endif
 
 
 typedef struct _TFFNStrBuilder {
@@ -176,6 +217,15 @@ typedef struct _TFFNStrBuilder {
     size_t capacity;  // maximum amount of letters that can fit into buffer
 } TFFNStrBuilder;
 
+// How the output of an action gets escaped, see tffn_parser_set_action_escape and tffn_parser_set_format_escape
+typedef enum _TFFNEscape {
+    TFFN_ESCAPE_DEFAULT = 0,  // actions use the mode of the format, formats dont escape anything
+    TFFN_ESCAPE_RAW,          // never escaped, even inside an escaped format
+    TFFN_ESCAPE_HTML,         // & < > " ' become &amp; &lt; &gt; &quot; &#39;
+    TFFN_ESCAPE_JSON,         // for the inside of a JSON string, " \ and control characters get backslash escapes
+    TFFN_ESCAPE_SHELL,        // single quoted as a single POSIX shell word, ' becomes '\''
+} TFFNEscape;
+
 TFFNStrBuilder* tffn_sb_new(size_t);
 void tffn_sb_append_sized(TFFNStrBuilder*, const char*, size_t);
 void tffn_sb_append_nterm(TFFNStrBuilder*, const char*);
@@ -183,56 +233,441 @@ void tffn_sb_append_char(TFFNStrBuilder*, char);
 void tffn_sb_clear(TFFNStrBuilder*);
 void tffn_sb_free(TFFNStrBuilder*);
 char* tffn_sb_to_str(TFFNStrBuilder*);
+char* tffn_sb_reserve(TFFNStrBuilder*, size_t);
+void tffn_sb_commit(TFFNStrBuilder*, size_t);
+void tffn_sb_append_u64(TFFNStrBuilder*, uint64_t);
+void tffn_sb_append_i64(TFFNStrBuilder*, int64_t);
+void tffn_sb_append_hex(TFFNStrBuilder*, uint64_t);
+void tffn_sb_append_f64(TFFNStrBuilder*, double);
+void tffn_sb_append_u64_padded(TFFNStrBuilder*, uint64_t, size_t, char);
+void tffn_sb_append_i64_padded(TFFNStrBuilder*, int64_t, size_t, char);
+void tffn_sb_append_hex_padded(TFFNStrBuilder*, uint64_t, size_t);
+void tffn_sb_append_escaped(TFFNStrBuilder*, const char*, size_t, TFFNEscape);
+void tffn_sb_escape_tail(TFFNStrBuilder*, size_t, TFFNEscape);
 
 typedef struct _TFFNEntry {
     char* key; // must be NULL terminated!
     size_t key_length;
+    uint64_t hash; // hash of the key, stored so resizing the table doesnt need to rehash
     void* object;
     struct _TFFNEntry* next;
 } __TFFNEntry;
 
+// How the format cache hashes formats, see tffn_parser_set_hash_mode
+typedef enum _TFFNHashMode {
+    TFFN_HASH_KEYED = 0, // SipHash-1-3 with a random key per parser, safe for formats from untrusted users
+    TFFN_HASH_FAST,      // faster but unkeyed, anyone that can choose formats can make them collide
+} TFFNHashMode;
+
 typedef struct _TFFNHashTable {
     uint32_t table_size;
+    uint32_t entry_count;
     __TFFNEntry** entries;
+    TFFNHashMode mode;
+    uint64_t key[2]; // SipHash key, only used by TFFN_HASH_KEYED
 } __TFFNHashTable;
 
-typedef struct _TFFNFuncEntry {
+typedef enum _TFFNActionKind {
+    __TFFN_ACTION_STATIC,
+    __TFFN_ACTION_DYNAMIC,
+    __TFFN_ACTION_PARAM,   // dynamic action that takes arguments, see tffn_parser_define_param_action
+    __TFFN_ACTION_ASYNC,   // dynamic action that can ask to be resumed later, see tffn_parser_define_async_action
+} __TFFNActionKind;
+
+// A single argument of a parameterized action, "[pad:5,x]" has two arguments: "5" and "x"
+typedef struct _TFFNArg {
+    const char* str;  // NULL terminated
+    size_t length;
+} TFFNArg;
+
+// Tells the parser how often the output of a dynamic action can change
+typedef enum _TFFNActionPolicy {
+    TFFN_ACTION_VOLATILE = 0,  // runs on every parse, this is the default
+    TFFN_ACTION_PURE,          // runs only once, its output gets folded into the static text
+    TFFN_ACTION_EPOCH,         // output is memoized until tffn_parser_bump_epoch gets called
+} TFFNActionPolicy;
+
+// What an asynchronous action tells the renderer, see tffn_parser_define_async_action
+typedef enum _TFFNAsyncStatus {
+    TFFN_ASYNC_DONE = 0,  // the output got appended, rendering goes on
+    TFFN_ASYNC_PENDING,   // the output isnt ready yet, rendering stops until the action is resumed
+} TFFNAsyncStatus;
+
+// Static and dynamic actions share a single namespace, so they are stored in a single table
+typedef struct _TFFNAction {
     char* key; // must be NULL terminated!
     size_t key_length;
-    void(*func)(TFFNStrBuilder*);
-    struct _TFFNFuncEntry* next;
-} __TFFNFuncEntry;
-
-typedef struct _TFFNFuncHashTable {
+    uint64_t hash; // hash of the key, stored so resizing the table doesnt need to rehash
+    __TFFNActionKind kind;
+    const char* static_act; // only used by static actions, not copied
+    size_t static_act_length;
+    void(*dynamic_act)(TFFNStrBuilder*); // only used by dynamic actions
+    void(*param_act)(TFFNStrBuilder*, const TFFNArg*, size_t); // only used by parameterized actions
+    TFFNAsyncStatus(*async_act)(TFFNStrBuilder*, void**); // only used by asynchronous actions
+    TFFNActionPolicy policy; // only used by dynamic actions
+    bool parallel; // thread safe and independent of the other actions, see tffn_parser_set_parallel_action
+    TFFNEscape escape; // see tffn_parser_set_action_escape
+    TFFNStrBuilder* memo; // last output of a pure or epoch action, NULL if it never ran
+    uint64_t memo_epoch; // parser epoch at the time memo was filled
+    struct _TFFNTemplate** dependents; // compiled templates that folded this static action in
+    size_t dependent_count;
+    size_t dependent_capacity;
+    bool in_arena; // true if both this entry and its key live inside a __TFFNArena
+    struct _TFFNAction* next;
+} __TFFNAction;
+
+typedef struct _TFFNActionTable {
     uint32_t table_size;
-    __TFFNFuncEntry** entries;
-} __TFFNFuncHashTable;
+    uint32_t entry_count;
+    __TFFNAction** entries;
+} __TFFNActionTable;
+
+// One slot of a __TFFNPerfectHash, its key lives inside the packed keys of the table
+typedef struct _TFFNPerfectSlot {
+    uint64_t hash;
+    uint32_t key_offset;
+    uint32_t key_length;
+    __TFFNAction* action;
+} __TFFNPerfectSlot;
+
+// Minimal perfect hash over the actions of a frozen parser (hash and displace, like CHD), a name
+// is found with one hash, one probe and one memcmp. The whole table is a single allocation:
+// this header, then slot_count slots, then two displacements per bucket and then all of the keys
+typedef struct _TFFNPerfectHash {
+    size_t byte_size;       // size of the whole allocation
+    uint32_t slot_count;    // exactly the amount of actions
+    uint32_t bucket_count;
+    uint64_t seed;
+    __TFFNPerfectSlot* slots;
+    uint32_t* displacements;
+    char* keys;
+} __TFFNPerfectHash;
+
+// A single allocation that holds the entries and packed keys of one bulk definition
+typedef struct _TFFNArena {
+    size_t byte_size; // including this header
+    struct _TFFNArena* next;
+} __TFFNArena;
+
+// A block of memory that interned strings are carved out of, the strings come right after this header
+// Every byte below used belongs to a block (a live string or a free block), so a slab can be walked
+// from its start. Free blocks are reused by later strings, see __tffn_strings_alloc
+typedef struct _TFFNStringSlab {
+    struct _TFFNStringPool* owner;
+    struct _TFFNStringSlab* prev;
+    struct _TFFNStringSlab* next;
+    size_t capacity;    // bytes after the header
+    size_t used;
+    size_t live_count;  // strings inside this slab that are still referenced
+    size_t free_bytes;  // bytes of the free blocks below used
+    size_t fit_hint;    // no run of free blocks below used is longer than this
+    bool evacuate;      // its strings are being moved out, see __tffn_parser_compact_strings
+} __TFFNStringSlab;
+
+// A static text of compiled formats that is stored only once per parser, the NULL terminated text
+// comes right after this header. Free blocks have the same header with a ref_count of 0
+typedef struct _TFFNPooledString {
+    __TFFNStringSlab* slab;         // NULL once the string got moved to next by __tffn_parser_compact_strings
+    struct _TFFNPooledString* next; // next string inside the same bucket
+    uint64_t hash;
+    size_t length;
+    size_t size;        // bytes of the whole block, header included
+    size_t ref_count;   // static steps that point to this text
+    bool pinned;        // a view of tffn_parser_render_view may point to it, it must never move
+} __TFFNPooledString;
+
+// Content addressed store of the static text of compiled formats, identical texts (like headers and
+// footers that many formats share) are stored once and reference counted
+typedef struct _TFFNStringPool {
+    __TFFNPooledString** buckets;
+    uint32_t bucket_count;      // always a power of two
+    uint32_t string_count;
+    uint64_t key[2];            // SipHash key, formats can come from untrusted users
+    __TFFNStringSlab* slabs;    // the first one is the slab that new strings go into
+} __TFFNStringPool;
+
+typedef enum _TFFNStepKind {
+    __TFFN_STEP_STATIC,
+    __TFFN_STEP_DYNAMIC,
+    __TFFN_STEP_SLOT,      // formats one of the values given to tffn_parser_render
+} __TFFNStepKind;
 
 typedef struct _TFFNStep {
-    void (*dynamic_step)(TFFNStrBuilder*); // function to run
-    const char* static_step; // already existing string to replace
+    __TFFNStepKind kind;
+    __TFFNAction* dynamic_step; // dynamic action to run
+    const char* static_step; // already existing string to replace, interned inside the string pool of the parser
+    size_t static_length;
+    TFFNArg* args; // arguments of a parameterized action, split once while compiling
+    size_t arg_count;
+    size_t slot; // index of the value to format for slot steps
+    TFFNEscape escape; // escaping mode of the format, used by dynamic and slot steps
     struct _TFFNStep* next;
 } __TFFNStep;
 
+// Every error that can be reported by a parser, see tffn_parser_err and tffn_parser_err_msg
+typedef enum _TFFNErrorCode {
+    TFFN_OK = 0,
+    TFFN_ERR_NESTED_BRACKET,     // '[' inside of a bracket
+    TFFN_ERR_UNOPENED_BRACKET,   // ']' without a '['
+    TFFN_ERR_UNCLOSED_BRACKET,   // format ended inside of a bracket
+    TFFN_ERR_BANG_IN_BRACKET,    // '!' inside of a bracket
+    TFFN_ERR_TRAILING_BANG,      // format ended with a single '!'
+    TFFN_ERR_UNDEFINED_ACTION,   // bracket names an action that doesnt exist
+    TFFN_ERR_UNEXPECTED_ARGS,    // arguments given to an action that isnt parameterized
+    TFFN_ERR_MISSING_VALUES,     // tffn_parser_render got less values than the format needs
+    TFFN_ERR_DUPLICATE_ACTION,   // an action with the same name already exists
+    TFFN_ERR_NOT_STATIC_ACTION,  // tffn_parser_update_static_action was used on a dynamic action
+    TFFN_ERR_FROZEN_PARSER,      // actions cant be defined to a frozen parser, see tffn_parser_freeze
+    TFFN_ERR_ACTION_PENDING,     // an asynchronous action couldnt finish during a synchronous render
+} TFFNErrorCode;
+
+// A compact description of an error, this never owns any memory
+typedef struct _TFFNError {
+    TFFNErrorCode code;
+    size_t offset;       // position inside the format where the error was found
+    size_t span_offset;  // position of the offending text (like an undefined action's name)
+    size_t span_length;  // 0 if the error doesnt have any offending text
+} TFFNError;
+
+// A compiled format string that lives inside the format cache
+typedef struct _TFFNTemplate {
+    __TFFNStep* steps;
+    size_t slot_count; // how many values tffn_parser_render needs at least, 0 if no slots are used
+    const char* format; // key of this template inside the format cache
+    size_t format_length;
+    TFFNError error; // error.code isnt TFFN_OK if this is a cached compilation failure
+    uint64_t action_generation; // parser->action_generation at the time the failure got cached
+    bool stale; // a static action this template depends on was updated, recompile before using it
+    bool rebind; // the recompilation can depend on other actions (an inherited one got shadowed)
+    size_t pin_count; // asynchronous renders that are still running the steps of this template
+    size_t hold_count; // render states that keep using this template, see tffn_parser_new_render_state
+    uint64_t version; // increases every time the steps get recompiled
+    struct _TFFNRetiredSteps* retired; // old steps that pinned renders may still use
+    TFFNEscape escape; // see tffn_parser_set_format_escape
+    uint64_t last_use; // parser->clock at the last time this template got used
+    struct _TFFNColdText* cold; // compressed static text while this template is cold, NULL while it is hot
+} __TFFNTemplate;
+
+// Static text of a cold template, static steps whose static_step is NULL get their text from here
+// in step order, the compressed bytes come right after this header
+typedef struct _TFFNColdText {
+    size_t raw_length;
+    size_t packed_length;
+} __TFFNColdText;
+
+// Steps that a stale template replaced while it was pinned, freed once the template is unpinned
+typedef struct _TFFNRetiredSteps {
+    __TFFNStep* steps;
+    struct _TFFNRetiredSteps* next;
+} __TFFNRetiredSteps;
+
+// A slot of the pointer keyed cache in front of the format cache, see tffn_parser_set_immutable_formats
+typedef struct _TFFNL0Entry {
+    const char* format; // pointer that the user gave, not owned
+    size_t format_length;
+    __TFFNTemplate* tmpl;
+} __TFFNL0Entry;
+
+// Simple growable array of actions, used to collect the dependencies of the format being compiled
+typedef struct _TFFNActionList {
+    __TFFNAction** items;
+    size_t count;
+    size_t capacity;
+} __TFFNActionList;
+
 
 typedef struct _TFFNParser {
-    __TFFNFuncHashTable* dynamic_actions;  // Objects are "void(*func)(TFFNStrBuilder*)"
-    __TFFNHashTable* static_actions;       // Objects are "char*"
-    __TFFNHashTable* format_cache;         // Objects are "__TFFNStep*"
-    TFFNStrBuilder* sb_err;                // not NULL if an exception happened
+    __TFFNActionTable* actions;            // both static and dynamic actions
+    __TFFNHashTable* format_cache;         // Objects are "__TFFNTemplate*"
+    TFFNError err;                         // error of the last operation, err.code is TFFN_OK if it succeeded
+    const char* err_text;                  // text that the offsets of err point into
+    TFFNStrBuilder* sb_err;                // owns err_text when it doesnt belong to a cached format
     TFFNStrBuilder* sb_res;                // for speed
     TFFNStrBuilder* sb_part;               // for speed
-    TFFNStrBuilder* sb_brack;              // for speed
+    __TFFNArena* arenas;                   // memory blocks created by bulk definitions
+    __TFFNActionList compile_deps;         // static actions used by the format being compiled
+    uint64_t epoch;                        // memoized outputs of epoch actions from older epochs are stale
+    uint64_t action_generation;            // increases every time a new action gets defined
+    size_t failure_count;                  // how many invalid formats are inside format_cache
+    __TFFNL0Entry l0[TFFN_L0_CACHE_SIZE];  // templates of recently used format pointers
+    bool immutable_formats;                // the contents behind a format pointer never change
+    struct _TFFNParser* base;              // actions that arent in this parser are looked up here, can be NULL
+    __TFFNActionTable* adopted;            // own copies of pure and epoch actions of its bases, never seen by its children, can be NULL
+    uint64_t ref_count;                    // the parser itself plus every child that uses it as its base, atomic
+    bool frozen_for_good;                  // set by tffn_parser_freeze, see __tffn_parser_frozen
+    __TFFNPerfectHash* perfect_hash;       // lookup table of tffn_parser_freeze, NULL if it couldnt be built
+    size_t numa_node_count;                // 0 if NUMA replication is off, see tffn_parser_enable_numa
+    size_t numa_node;                      // node of the thread that uses this parser
+    __TFFNPerfectHash* replicas[TFFN_MAX_NUMA_NODES]; // per node copies of perfect_hash (and its actions), atomic
+    struct _TFFNWorkerPool* pool;          // runs parallel actions, NULL if tffn_parser_set_worker_count wasnt used
+    __TFFNStringPool* strings;             // static text of every compiled format
+    uint64_t clock;                        // increases every time a compiled format gets used
+    uint64_t id;                           // unique for the whole process, ids of freed parsers are never reused
+    uint64_t seed[2];                      // random bits that every hash key of the parser (and its children) comes from
+    uint64_t key_count;                    // how many keys got derived from seed
 } TFFNParser;
 
+// One element of the array given to tffn_parser_define_static_actions
+typedef struct _TFFNStaticActionDef {
+    const char* act_text;      // doesnt need to be NULL terminated
+    size_t act_text_length;
+    const char* static_act;    // must be NULL terminated, not copied (just like the single version)
+} TFFNStaticActionDef;
+
+// One element of the array given to tffn_parser_define_dynamic_actions
+typedef struct _TFFNDynamicActionDef {
+    const char* act_text;      // doesnt need to be NULL terminated
+    size_t act_text_length;
+    void(*dynamic_act)(TFFNStrBuilder*);
+    TFFNActionPolicy policy;   // see tffn_parser_define_dynamic_action_ex
+} TFFNDynamicActionDef;
+
+// Per element outcome of a bulk definition
+typedef enum _TFFNDefineResult {
+    TFFN_DEFINE_OK = 0,
+    TFFN_DEFINE_DUPLICATE,     // the name already exists or appeared earlier in the same array
+    TFFN_DEFINE_INVALID,       // empty name or NULL action
+    TFFN_DEFINE_FROZEN,        // the parser is frozen, see tffn_parser_freeze and tffn_parser_new_child
+} TFFNDefineResult;
+
+// Type of a value given to tffn_parser_render
+typedef enum _TFFNValueType {
+    TFFN_VALUE_STR,
+    TFFN_VALUE_I64,
+    TFFN_VALUE_F64,
+} TFFNValueType;
+
+// A value that fills a "[$N]" slot, see tffn_value_str, tffn_value_i64 and tffn_value_f64
+typedef struct _TFFNValue {
+    TFFNValueType type;
+    union {
+        struct { const char* ptr; size_t length; } str;  // doesnt need to be NULL terminated
+        int64_t i64;
+        double f64;
+    } as;
+} TFFNValue;
+
+// A borrowed string, see tffn_parser_render_view
+typedef struct _TFFNStrView {
+    const char* str; // NULL terminated, NULL if an error happened
+    size_t length;
+} TFFNStrView;
+
+// State of an asynchronous render, see tffn_async_status
+typedef enum _TFFNRenderStatus {
+    TFFN_RENDER_DONE = 0,
+    TFFN_RENDER_PENDING,  // waiting for an asynchronous action, see tffn_async_resume
+} TFFNRenderStatus;
+
+// A render that can stop at an asynchronous action and continue later, see tffn_parser_render_async
+typedef struct _TFFNAsyncRender {
+    TFFNParser* parser;
+    __TFFNTemplate* tmpl;      // pinned until the render is freed
+    __TFFNStep* step;          // next step to run, NULL once the render is done
+    const TFFNValue* values;   // not copied, they must stay alive until the render is done
+    TFFNStrBuilder* sb;        // output so far
+    void* token;               // continuation token of the pending action, NULL if it is not pending
+} TFFNAsyncRender;
+
+// A byte range of a render state's result that changed, see tffn_render_state_changes
+typedef struct _TFFNChange {
+    size_t offset;      // where the range starts inside the new result
+    size_t old_length;  // how many bytes of the previous result got replaced
+    size_t new_length;  // how many bytes replaced them
+} TFFNChange;
+
+// Keeps the last result of a format together with the span of every step, so rendering it again
+// only patches and reports the parts that changed, see tffn_parser_new_render_state
+typedef struct _TFFNRenderState {
+    TFFNParser* parser;
+    __TFFNTemplate* tmpl;      // held until the state is freed
+    uint64_t version;          // tmpl->version that the spans belong to
+    bool rendered;             // false until the first successful update
+    size_t* lengths;           // length of every step's output inside sb, in step order
+    size_t step_capacity;
+    TFFNStrBuilder* sb;        // result of the last update
+    TFFNStrBuilder* scratch;   // new output of the step being compared
+    TFFNChange* changes;       // changes of the last update
+    size_t change_count;
+    size_t change_capacity;
+} TFFNRenderState;
+
+// Bytes that a parser holds on to, split by what they are used for, see tffn_parser_memory_usage
+typedef struct _TFFNMemoryUsage {
+    size_t actions;      // action table, actions with their names, memoized outputs and dependent lists
+    size_t lookup;       // perfect hash of tffn_parser_freeze and its NUMA replicas
+    size_t cache_table;  // format cache buckets, entries and templates
+    size_t cache_keys;   // copies of the cached formats
+    size_t steps;        // compiled steps with their arguments, retired ones included
+    size_t strings;      // static text of the compiled formats, see __TFFNStringPool
+    size_t cold;         // compressed static text and steps of cold formats, see tffn_parser_compress_cold
+    size_t scratch;      // builders and lists that get reused between calls (and the worker pool)
+    size_t total;        // everything above plus the parser itself
+    size_t hot_formats;  // how many compiled formats are ready to be rendered (not bytes)
+    size_t cold_formats; // how many compiled formats are compressed (not bytes)
+} TFFNMemoryUsage;
+
+void tffn_sb_append_value(TFFNStrBuilder*, const TFFNValue*);
+
+TFFNValue tffn_value_str(const char*, size_t);
+TFFNValue tffn_value_i64(int64_t);
+TFFNValue tffn_value_f64(double);
+
 TFFNParser* tffn_parser_new();
+TFFNParser* tffn_parser_new_child(TFFNParser*);
+TFFNParser* tffn_parser_new_child_on_node(TFFNParser*, size_t);
+void tffn_parser_freeze(TFFNParser*);
+void tffn_parser_enable_numa(TFFNParser*, size_t);
+void tffn_parser_set_parallel_action(TFFNParser*, const char*, bool);
+void tffn_parser_set_worker_count(TFFNParser*, size_t);
+void tffn_parser_set_action_escape(TFFNParser*, const char*, TFFNEscape);
+void tffn_parser_set_format_escape(TFFNParser*, const char*, size_t, TFFNEscape);
 bool tffn_parser_okay(TFFNParser*);
-void tffn_parser_define_static_action(TFFNParser*, char*, char*);
-void tffn_parser_define_dynamic_action(TFFNParser*, char*, void(*f)(TFFNStrBuilder*));
+void tffn_parser_define_static_action(TFFNParser*, const char*, const char*);
+void tffn_parser_define_static_action_n(TFFNParser*, const char*, size_t, const char*, size_t);
+void tffn_parser_define_dynamic_action(TFFNParser*, const char*, void(*f)(TFFNStrBuilder*));
+void tffn_parser_define_dynamic_action_ex(TFFNParser*, const char*, void(*f)(TFFNStrBuilder*), TFFNActionPolicy);
+void tffn_parser_define_dynamic_action_n(TFFNParser*, const char*, size_t, void(*f)(TFFNStrBuilder*), TFFNActionPolicy);
+void tffn_parser_define_param_action(TFFNParser*, const char*, void(*f)(TFFNStrBuilder*, const TFFNArg*, size_t));
+void tffn_parser_define_param_action_n(TFFNParser*, const char*, size_t, void(*f)(TFFNStrBuilder*, const TFFNArg*, size_t));
+void tffn_parser_define_async_action(TFFNParser*, const char*, TFFNAsyncStatus(*f)(TFFNStrBuilder*, void**));
+void tffn_parser_define_async_action_n(TFFNParser*, const char*, size_t, TFFNAsyncStatus(*f)(TFFNStrBuilder*, void**));
+void tffn_parser_update_static_action(TFFNParser*, const char*, const char*);
+void tffn_parser_update_static_action_n(TFFNParser*, const char*, size_t, const char*, size_t);
+void tffn_parser_bump_epoch(TFFNParser*);
+void tffn_parser_set_hash_mode(TFFNParser*, TFFNHashMode);
+void tffn_parser_set_immutable_formats(TFFNParser*, bool);
+size_t tffn_parser_define_static_actions(TFFNParser*, const TFFNStaticActionDef*, size_t, TFFNDefineResult*);
+size_t tffn_parser_define_dynamic_actions(TFFNParser*, const TFFNDynamicActionDef*, size_t, TFFNDefineResult*);
 char* tffn_parser_parse(TFFNParser*, const char*);
+char* tffn_parser_parse_n(TFFNParser*, const char*, size_t);
+char* tffn_parser_render(TFFNParser*, const char*, const TFFNValue*, size_t);
+char* tffn_parser_render_n(TFFNParser*, const char*, size_t, const TFFNValue*, size_t);
+TFFNStrView tffn_parser_render_view(TFFNParser*, const char*, size_t, const TFFNValue*, size_t);
 char* tffn_parser_err_msg(TFFNParser*);
+bool tffn_parser_validate(TFFNParser*, const char*, size_t, TFFNError*);
+__TFFNAction* tffn_parser_find_action(TFFNParser*, const char*, size_t);
+bool tffn_parser_run_action(TFFNParser*, __TFFNAction*, const TFFNArg*, size_t, TFFNStrBuilder*);
+TFFNAsyncRender* tffn_parser_render_async(TFFNParser*, const char*, size_t, const TFFNValue*, size_t);
+TFFNRenderStatus tffn_async_status(TFFNAsyncRender*);
+TFFNRenderStatus tffn_async_resume(TFFNAsyncRender*);
+void* tffn_async_token(TFFNAsyncRender*);
+TFFNStrView tffn_async_result(TFFNAsyncRender*);
+void tffn_async_free(TFFNAsyncRender*);
+TFFNRenderState* tffn_parser_new_render_state(TFFNParser*, const char*, size_t);
+bool tffn_render_state_update(TFFNRenderState*, const TFFNValue*, size_t);
+const TFFNChange* tffn_render_state_changes(TFFNRenderState*, size_t*);
+TFFNStrView tffn_render_state_result(TFFNRenderState*);
+void tffn_render_state_free(TFFNRenderState*);
+TFFNMemoryUsage tffn_parser_memory_usage(TFFNParser*);
+void tffn_parser_shrink(TFFNParser*, size_t);
+size_t tffn_parser_compress_cold(TFFNParser*, uint64_t);
+const TFFNError* tffn_parser_err(TFFNParser*);
 void tffn_parser_free(TFFNParser*);
 
+#ifdef __cplusplus
+}  // closing the name mangling fix paranthesis for C++
+#endif
 
 #endif // TFFN_H
 
@@ -241,6 +676,41 @@ void tffn_parser_free(TFFNParser*);
 
 #ifdef TFFN_IMPLEMENTATION
 
+#ifdef TFFN_ENABLE_THREADS
+    #ifdef _WIN32
+        #include <windows.h>
+    #else
+        #include <pthread.h>
+    #endif
+#endif
+
+// Internal helper macros, not meant to be used by this library's users
+// Atomic operations for the few fields that can be changed by several threads at the same time
+// (parser ids, reference counts of bases and NUMA replicas), other compilers get plain operations
+#if defined(__GNUC__) || defined(__clang__)
+    #define __tffn_atomic_add(ptr, amount) __atomic_add_fetch((ptr), (amount), __ATOMIC_ACQ_REL)
+    #define __tffn_atomic_sub(ptr, amount) __atomic_sub_fetch((ptr), (amount), __ATOMIC_ACQ_REL)
+    #define __tffn_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+    #define __tffn_atomic_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+    #define __tffn_atomic_publish(ptr, value) __sync_bool_compare_and_swap((ptr), NULL, (value))
+#elif defined(_MSC_VER)
+    #include <intrin.h>
+    #define __tffn_atomic_add(ptr, amount) \
+        ((uint64_t) _InterlockedExchangeAdd64((volatile __int64*) (ptr), (__int64) (amount)) + (amount))
+    #define __tffn_atomic_sub(ptr, amount) \
+        ((uint64_t) _InterlockedExchangeAdd64((volatile __int64*) (ptr), -(__int64) (amount)) - (amount))
+    #define __tffn_atomic_load(ptr) (_ReadWriteBarrier(), *(ptr)) // aligned loads are atomic on x86 and ARM64
+    #define __tffn_atomic_store(ptr, value) do { _ReadWriteBarrier(); *(ptr) = (value); } while(0)
+    #define __tffn_atomic_publish(ptr, value) \
+        (_InterlockedCompareExchangePointer((void* volatile*) (ptr), (void*) (value), NULL) == NULL)
+#else
+    #define __tffn_atomic_add(ptr, amount) (*(ptr) += (amount))
+    #define __tffn_atomic_sub(ptr, amount) (*(ptr) -= (amount))
+    #define __tffn_atomic_load(ptr) (*(ptr))
+    #define __tffn_atomic_store(ptr, value) (*(ptr) = (value))
+    #define __tffn_atomic_publish(ptr, value) (*(ptr) == NULL ? (*(ptr) = (value), true) : false)
+#endif
+
 #ifdef __cplusplus
 extern "C" {  // prevents name mangling of functions when used in C++
 #endif
@@ -277,7 +747,7 @@ void tffn_sb_append_sized(TFFNStrBuilder* sb, const char* buffer, size_t char_co
     }
 
     if(need_to_realloc == 1) {
-        sb->buffer = TFFN_REALLOC(sb->buffer, sb->capacity * sizeof(char));
+        sb->buffer = (char*) TFFN_REALLOC(sb->buffer, sb->capacity * sizeof(char));
         TFFN_ASSERT(sb->buffer != NULL && "Couldn't allocate memory");
     }
 
@@ -292,7 +762,7 @@ void tffn_sb_append_char(TFFNStrBuilder* sb, char c) {
 
     if (sb->count + 1 > sb->capacity) {
         sb->capacity *= 2;
-        sb->buffer = TFFN_REALLOC(sb->buffer, sb->capacity * sizeof(char));
+        sb->buffer = (char*) TFFN_REALLOC(sb->buffer, sb->capacity * sizeof(char));
         TFFN_ASSERT(sb->buffer != NULL && "Couldn't allocate memory");
     }
 
@@ -343,11 +813,216 @@ char* tffn_sb_to_str(TFFNStrBuilder* sb) {
 }
 
 
+// Makes sure at least char_count more characters fit into sb and returns a pointer to the first
+// one of them, after writing into this space call tffn_sb_commit with the amount that got written
+// This lets dynamic actions format things right into the builder without temporary buffers
+char* tffn_sb_reserve(TFFNStrBuilder* sb, size_t char_count) {
+    if(sb->count + char_count > sb->capacity) {
+        while(sb->count + char_count > sb->capacity) {
+            sb->capacity *= 2;
+        }
+        sb->buffer = (char*) TFFN_REALLOC(sb->buffer, sb->capacity * sizeof(char));
+        TFFN_ASSERT(sb->buffer != NULL && "Couldn't allocate memory");
+    }
+
+    return sb->buffer + sb->count;
+}
+
+
+// Marks char_count characters that were written into the space returned by tffn_sb_reserve as used
+void tffn_sb_commit(TFFNStrBuilder* sb, size_t char_count) {
+    TFFN_ASSERT(sb->count + char_count <= sb->capacity);
+    sb->count += char_count;
+}
+
+
+// Internal helper data, not meant to be used by this library's users
+// Two characters for every number in [0, 100), lets the conversions write two digits at a time
+static const char __tffn_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+// Internal helper function, not meant to be used by this library's users
+static size_t __tffn_u64_digit_count(uint64_t num) {
+    size_t count = 1;
+    while(num >= 10000) { num /= 10000; count += 4; }
+    if(num >= 1000) return count + 3;
+    if(num >= 100) return count + 2;
+    if(num >= 10) return count + 1;
+    return count;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Writes the digits of num so that the last one ends right before end
+static void __tffn_write_u64_backwards(char* end, uint64_t num) {
+    while(num >= 100) {
+        size_t pair = (size_t) (num % 100) * 2;
+        num /= 100;
+        *--end = __tffn_digit_pairs[pair + 1];
+        *--end = __tffn_digit_pairs[pair];
+    }
+
+    if(num >= 10) {
+        size_t pair = (size_t) num * 2;
+        *--end = __tffn_digit_pairs[pair + 1];
+        *--end = __tffn_digit_pairs[pair];
+    }
+    else {
+        *--end = (char) ('0' + num);
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Appends the sign and the digits of a number, padded from the left up to width characters
+// If pad is '0' the zeros go after the sign ("-0042"), otherwise before it ("  -42")
+static void __tffn_sb_append_digits(TFFNStrBuilder* sb, bool negative, uint64_t abs_num, size_t width, char pad) {
+    size_t digit_count = __tffn_u64_digit_count(abs_num);
+    size_t length = digit_count + (negative ? 1 : 0);
+    size_t pad_count = (width > length) ? width - length : 0;
+
+    char* out = tffn_sb_reserve(sb, length + pad_count);
+    if(pad == '0') {
+        if(negative) *out++ = '-';
+        memset(out, '0', pad_count);
+        out += pad_count;
+    }
+    else {
+        memset(out, pad, pad_count);
+        out += pad_count;
+        if(negative) *out++ = '-';
+    }
+
+    __tffn_write_u64_backwards(out + digit_count, abs_num);
+    tffn_sb_commit(sb, length + pad_count);
+}
+
+
+// Appends the decimal representation of num into the string builder
+void tffn_sb_append_u64(TFFNStrBuilder* sb, uint64_t num) {
+    __tffn_sb_append_digits(sb, false, num, 0, ' ');
+}
+
+
+// Appends the decimal representation of num into the string builder
+void tffn_sb_append_i64(TFFNStrBuilder* sb, int64_t num) {
+    // Work with the absolute value as unsigned so INT64_MIN doesnt overflow
+    uint64_t abs_num = (num < 0) ? 0 - (uint64_t) num : (uint64_t) num;
+    __tffn_sb_append_digits(sb, num < 0, abs_num, 0, ' ');
+}
+
+
+// Appends the decimal representation of num, padded from the left with pad until it is width long
+void tffn_sb_append_u64_padded(TFFNStrBuilder* sb, uint64_t num, size_t width, char pad) {
+    __tffn_sb_append_digits(sb, false, num, width, pad);
+}
+
+
+// Appends the decimal representation of num, padded from the left with pad until it is width long
+// If pad is '0' the zeros go after the minus sign, so -42 with width 5 becomes "-0042"
+void tffn_sb_append_i64_padded(TFFNStrBuilder* sb, int64_t num, size_t width, char pad) {
+    uint64_t abs_num = (num < 0) ? 0 - (uint64_t) num : (uint64_t) num;
+    __tffn_sb_append_digits(sb, num < 0, abs_num, width, pad);
+}
+
+
+// Appends the lowercase hexadecimal representation of num (without any "0x" prefix),
+// padded from the left with zeros until it is width long
+void tffn_sb_append_hex_padded(TFFNStrBuilder* sb, uint64_t num, size_t width) {
+    static const char hex_digits[] = "0123456789abcdef";
+
+    size_t digit_count = 1;
+    for (uint64_t temp = num >> 4; temp != 0; temp >>= 4) digit_count++;
+    size_t length = (width > digit_count) ? width : digit_count;
+
+    char* out = tffn_sb_reserve(sb, length);
+    char* end = out + length;
+    for (size_t i = 0; i < length; i++) {
+        *--end = hex_digits[num & 0xF];
+        num >>= 4;
+    }
+    tffn_sb_commit(sb, length);
+}
+
+
+// Appends the lowercase hexadecimal representation of num (without any "0x" prefix)
+void tffn_sb_append_hex(TFFNStrBuilder* sb, uint64_t num) {
+    tffn_sb_append_hex_padded(sb, num, 0);
+}
+
+
+// Appends a decimal representation of num that reads back as the exact same double, using the
+// fewest significant digits for which the correctly rounded decimal still does so
+// Most numbers (anything that has a short decimal form between 1e-5 and 1e15) are written by
+// the integer routines above, only the rest falls back to snprintf
+void tffn_sb_append_f64(TFFNStrBuilder* sb, double num) {
+    if(num != num) { tffn_sb_append_sized(sb, "nan", 3); return; }
+    if(num > 1.7976931348623157e308) { tffn_sb_append_sized(sb, "inf", 3); return; }
+    if(num < -1.7976931348623157e308) { tffn_sb_append_sized(sb, "-inf", 4); return; }
+
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+    bool negative = (bits >> 63) != 0; // also catches -0.0
+    double abs_num = negative ? -num : num;
+
+    if(abs_num == 0) {
+        if(negative) tffn_sb_append_sized(sb, "-0", 2);
+        else tffn_sb_append_char(sb, '0');
+        return;
+    }
+
+    // Find the smallest k for which abs_num is exactly some_integer / 10^k, both that integer and
+    // 10^k are exact doubles so if their (correctly rounded) quotient gives back abs_num then
+    // the decimal string of that quotient also reads back as abs_num
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+    };
+    if(abs_num >= 1e-5 && abs_num < 1e15) {
+        for (size_t k = 0; k < sizeof(powers_of_ten) / sizeof(powers_of_ten[0]); k++) {
+            double scaled = abs_num * powers_of_ten[k];
+            if(scaled >= 9007199254740992.0) break; // 2^53, integers above it arent exact anymore
+
+            uint64_t mantissa = (uint64_t) (scaled + 0.5);
+            if((double) mantissa / powers_of_ten[k] != abs_num) continue;
+
+            uint64_t divisor = 1;
+            for (size_t i = 0; i < k; i++) divisor *= 10;
+            uint64_t int_part = mantissa / divisor;
+            uint64_t frac_part = mantissa % divisor;
+
+            __tffn_sb_append_digits(sb, negative, int_part, 0, ' ');
+            if(k > 0) {
+                tffn_sb_append_char(sb, '.');
+                __tffn_sb_append_digits(sb, false, frac_part, k, '0');
+            }
+            return;
+        }
+    }
+
+    // Fall back to the smallest precision that round trips, 17 digits always do
+    char* out = tffn_sb_reserve(sb, 32);
+    int length = 0;
+    for (int precision = 1; precision <= 17; precision++) {
+        length = snprintf(out, 32, "%.*g", precision, num);
+        if(precision == 17 || strtod(out, NULL) == num) break;
+    }
+
+    // snprintf uses the decimal point of the current locale, always use '.' instead
+    for (int i = 0; i < length; i++) {
+        if(out[i] == ',') out[i] = '.';
+    }
+    tffn_sb_commit(sb, (size_t) length);
+}
+
+
 // Internal helper function, not meant to be used by this library's users
-static size_t __tffn_htable_str_to_index(uint32_t table_size, const char* str) {
+static uint64_t __tffn_hash_sized(const char* str, size_t str_length) {
     uint64_t hash = 0;
 
-    size_t str_length = strlen(str);
     for (size_t i = 0; i < str_length; i++) {
         hash *= 17;
         hash += str[i];
@@ -362,38 +1037,254 @@ static size_t __tffn_htable_str_to_index(uint32_t table_size, const char* str) {
     hash *= 0xC4CEB9FE1A85EC53L;
     hash ^= hash >> 33;
 
-    // Compute the index which is in range [0, ht->table_size)
-    size_t index = hash % table_size;
-    return index;
+    return hash;
 }
 
 
+#define __TFFN_ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+#define __TFFN_SIPROUND do {                                                          \
+        v0 += v1; v1 = __TFFN_ROTL(v1, 13); v1 ^= v0; v0 = __TFFN_ROTL(v0, 32);      \
+        v2 += v3; v3 = __TFFN_ROTL(v3, 16); v3 ^= v2;                                \
+        v0 += v3; v3 = __TFFN_ROTL(v3, 21); v3 ^= v0;                                \
+        v2 += v1; v1 = __TFFN_ROTL(v1, 17); v1 ^= v2; v2 = __TFFN_ROTL(v2, 32);      \
+    } while(0)
+
+
 // Internal helper function, not meant to be used by this library's users
-static void (*__tffn_fhtable_lookup(__TFFNFuncHashTable* ht, const char* key))(TFFNStrBuilder*) {
-    TFFN_ASSERT(ht != NULL);
-    TFFN_ASSERT(key != NULL);
+// SipHash-1-3 of the given string, the following implementation follows the reference
+// implementation of Jean-Philippe Aumasson and Daniel J. Bernstein (CC0):
+// https://github.com/veorq/SipHash
+static uint64_t __tffn_siphash13(const char* str, size_t str_length, uint64_t k0, uint64_t k1) {
+    uint64_t v0 = 0x736F6D6570736575ULL ^ k0;
+    uint64_t v1 = 0x646F72616E646F6DULL ^ k1;
+    uint64_t v2 = 0x6C7967656E657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    const unsigned char* in = (const unsigned char*) str;
+
+    size_t end = str_length - (str_length % 8);
+    for (size_t i = 0; i < end; i += 8) {
+        uint64_t m = 0;
+        for (int j = 7; j >= 0; j--) m = (m << 8) | in[i + j]; // little endian on every machine
+        v3 ^= m;
+        __TFFN_SIPROUND;
+        v0 ^= m;
+    }
 
-    size_t index = __tffn_htable_str_to_index(ht->table_size, key);
-    __TFFNFuncEntry* temp = ht->entries[index];
-    while(temp != NULL) {
-        if(strcmp(temp->key, key) == 0) break;
-        temp = temp->next;
+    uint64_t m = ((uint64_t) str_length) << 56;
+    for (size_t j = 0; j < str_length % 8; j++) {
+        m |= ((uint64_t) in[end + j]) << (8 * j);
     }
+    v3 ^= m;
+    __TFFN_SIPROUND;
+    v0 ^= m;
+
+    v2 ^= 0xFF;
+    __TFFN_SIPROUND;
+    __TFFN_SIPROUND;
+    __TFFN_SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
 
-    if(temp == NULL) return NULL;
-    return temp->func;
+
+// Internal helper function, not meant to be used by this library's users
+// Fills seed with 128 unpredictable bits, every parser calls this once and derives all of its hash
+// keys from them (children derive theirs from their base without calling it at all)
+// This can be replaced by defining TFFN_RANDOM_U64 (for example to use a proper CSPRNG) before
+// including the header file, it gets called twice per parser then
+#ifdef TFFN_RANDOM_U64
+
+static void __tffn_random_seed(uint64_t seed[2]) {
+    seed[0] = TFFN_RANDOM_U64();
+    seed[1] = TFFN_RANDOM_U64();
+}
+
+#else
+
+static void __tffn_random_seed(uint64_t seed[2]) {
+#ifndef _WIN32
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if(urandom != NULL) {
+        size_t read = fread(seed, sizeof(uint64_t), 2, urandom);
+        fclose(urandom);
+        if(read == 2) return;
+    }
+#endif
+
+    // No OS randomness, mix whatever changes between runs and calls with splitmix64
+    static uint64_t counter = 0;
+    for (int i = 0; i < 2; i++) {
+        uint64_t bits = (uint64_t) time(NULL) ^ ((uint64_t) clock() << 32) ^ (uint64_t) (uintptr_t) seed;
+        bits += __tffn_atomic_add(&counter, 1) * 0x9E3779B97F4A7C15ULL;
+        bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBULL;
+        seed[i] = bits ^ (bits >> 31);
+    }
+}
+
+#endif
+
+
+// Internal helper function, not meant to be used by this library's users
+// Derives a SipHash key from seed, different counters give unrelated keys and none of them
+// tell anything about seed or about each other
+static void __tffn_derive_key(const uint64_t seed[2], uint64_t counter, uint64_t key[2]) {
+    for (uint64_t i = 0; i < 2; i++) {
+        char input[8];
+        uint64_t word = counter * 2 + i;
+        for (int j = 0; j < 8; j++) input[j] = (char) (word >> (8 * j));
+        key[i] = __tffn_siphash13(input, sizeof(input), seed[0], seed[1]);
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Reads at most size - 1 characters of the first line of the given file, returns false if it cant be read
+static bool __tffn_read_sys_file(const char* path, char* buffer, size_t size) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) return false;
+
+    bool okay = fgets(buffer, (int) size, file) != NULL;
+    fclose(file);
+    return okay;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the amount of NUMA nodes, this can be replaced by defining TFFN_NUMA_NODE_COUNT
+// (for example to use numa_num_configured_nodes of libnuma) before including the header file
+#ifndef TFFN_NUMA_NODE_COUNT
+    #define TFFN_NUMA_NODE_COUNT() __tffn_numa_node_count()
+
+static size_t __tffn_numa_node_count(void) {
+    // Something like "0" or "0-1", the last number is the highest node
+    char online[256];
+    if(!__tffn_read_sys_file("/sys/devices/system/node/online", online, sizeof(online))) return 1;
+
+    size_t highest = 0, num = 0;
+    for (char* c = online; *c != '\0'; c++) {
+        if(*c >= '0' && *c <= '9') num = num * 10 + (size_t) (*c - '0');
+        else { highest = num; num = 0; }
+    }
+    if(num > highest) highest = num;
+    return highest + 1;
+}
+#endif
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the NUMA node of the CPU that the calling thread last ran on, this can be replaced by
+// defining TFFN_CURRENT_NUMA_NODE (for example to numa_node_of_cpu(sched_getcpu()) of libnuma)
+// before including the header file
+#ifndef TFFN_CURRENT_NUMA_NODE
+    #define TFFN_CURRENT_NUMA_NODE() __tffn_current_numa_node()
+
+static size_t __tffn_current_numa_node(void) {
+    // The 39th field of /proc/thread-self/stat is the CPU, the 2nd one is a name in parentheses
+    // that can have spaces in it so fields are counted from the last ')'
+    char stat[1024];
+    if(!__tffn_read_sys_file("/proc/thread-self/stat", stat, sizeof(stat))) return 0;
+
+    char* field = strrchr(stat, ')');
+    if(field == NULL) return 0;
+    for (int i = 2; i < 39 && field != NULL; i++) field = strchr(field + 1, ' ');
+    if(field == NULL) return 0;
+    size_t cpu = (size_t) strtoul(field + 1, NULL, 10);
+
+    // Every node lists its CPUs like "0-7,16-23"
+    for (size_t node = 0; node < TFFN_MAX_NUMA_NODES; node++) {
+        char path[64], cpulist[1024];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node);
+        if(!__tffn_read_sys_file(path, cpulist, sizeof(cpulist))) continue;
+
+        char* c = cpulist;
+        while(*c >= '0' && *c <= '9') {
+            size_t first = (size_t) strtoul(c, &c, 10), last = first;
+            if(*c == '-') last = (size_t) strtoul(c + 1, &c, 10);
+            if(cpu >= first && cpu <= last) return node;
+            if(*c == ',') c++;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+
+// Internal helper function, not meant to be used by this library's users
+static uint64_t __tffn_htable_hash(__TFFNHashTable* ht, const char* str, size_t str_length) {
+    if(ht->mode == TFFN_HASH_FAST) return __tffn_hash_sized(str, str_length);
+    return __tffn_siphash13(str, str_length, ht->key[0], ht->key[1]);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the smallest power of two table size that can hold entry_count entries
+// with a load factor of at most 1
+static uint32_t __tffn_htable_size_for(uint32_t current_size, size_t entry_count) {
+    uint32_t size = current_size;
+    while(size < entry_count && size < (UINT32_C(1) << 31)) {
+        size *= 2;
+    }
+    return size;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Puts every entry into the bucket of its hash, entry hashes must already be up to date
+static void __tffn_htable_rebucket(__TFFNHashTable* ht, uint32_t new_size) {
+    __TFFNEntry** new_entries = (__TFFNEntry**) TFFN_CALLOC(sizeof(__TFFNEntry*), new_size);
+    TFFN_ASSERT(new_entries != NULL && "Couldn't allocate memory");
+
+    for (uint32_t i = 0; i < ht->table_size; i++) {
+        __TFFNEntry* temp = ht->entries[i];
+        while(temp != NULL) {
+            __TFFNEntry* next = temp->next;
+            size_t index = temp->hash % new_size;
+            temp->next = new_entries[index];
+            new_entries[index] = temp;
+            temp = next;
+        }
+    }
+
+    TFFN_FREE(ht->entries);
+    ht->entries = new_entries;
+    ht->table_size = new_size;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_htable_resize(__TFFNHashTable* ht, uint32_t new_size) {
+    if(new_size <= ht->table_size) return;
+    __tffn_htable_rebucket(ht, new_size);
 }
 
 
 // Internal helper function, not meant to be used by this library's users
-static void* __tffn_htable_lookup(__TFFNHashTable* ht, const char* key) {
+// Switches the table to the given hash mode with a brand new key, every entry gets rehashed
+static void __tffn_htable_rekey(__TFFNHashTable* ht, TFFNHashMode mode) {
+    ht->mode = mode;
+    uint64_t old_key[2] = { ht->key[0], ht->key[1] };
+    __tffn_derive_key(old_key, 0, ht->key); // as unpredictable as the old key which came from the parser
+
+    for (uint32_t i = 0; i < ht->table_size; i++) {
+        for (__TFFNEntry* temp = ht->entries[i]; temp != NULL; temp = temp->next) {
+            temp->hash = __tffn_htable_hash(ht, temp->key, temp->key_length);
+        }
+    }
+
+    __tffn_htable_rebucket(ht, ht->table_size);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void* __tffn_htable_lookup(__TFFNHashTable* ht, const char* key, size_t key_length) {
     TFFN_ASSERT(ht != NULL);
-    TFFN_ASSERT(key != NULL);
+    TFFN_ASSERT(key != NULL || key_length == 0);
 
-    size_t index = __tffn_htable_str_to_index(ht->table_size, key);
-    __TFFNEntry* temp = ht->entries[index];
+    uint64_t hash = __tffn_htable_hash(ht, key, key_length);
+    __TFFNEntry* temp = ht->entries[hash % ht->table_size];
     while(temp != NULL) {
-        if(strcmp(temp->key, key) == 0) break;
+        if(temp->hash == hash && temp->key_length == key_length && memcmp(temp->key, key, key_length) == 0) break;
         temp = temp->next;
     }
 
@@ -403,439 +1294,3730 @@ static void* __tffn_htable_lookup(__TFFNHashTable* ht, const char* key) {
 
 
 // Internal helper function, not meant to be used by this library's users
-static void __tffn_htable_insert(__TFFNHashTable* ht, const char* key, void* object) {
+// Returns the new entry, or NULL if nothing got inserted
+// Chains never stay longer than TFFN_MAX_CHAIN_LENGTH for long: a fast table that gets one
+// switches to keyed hashing (someone is probably making formats collide on purpose) and a
+// keyed table just grows
+static __TFFNEntry* __tffn_htable_insert(__TFFNHashTable* ht, const char* key, size_t key_length, void* object) {
     TFFN_ASSERT(ht != NULL);
-    TFFN_ASSERT(key != NULL);
+    TFFN_ASSERT(key != NULL || key_length == 0);
     
     // Do nothing if the object being inserted is NULL
-    if(object == NULL) return;
+    if(object == NULL) return NULL;
 
     // Do nothing if the key already exists
-    size_t str_length = strlen(key);
-    if(__tffn_htable_lookup(ht, key) != NULL) return;
+    if(__tffn_htable_lookup(ht, key, key_length) != NULL) return NULL;
 
     // Create new entry
     __TFFNEntry* entry = (__TFFNEntry*) TFFN_MALLOC(sizeof(__TFFNEntry));
     TFFN_ASSERT(entry != NULL && "Couldn't allocate memory");
     entry->object = object;
-    entry->key = (char*) TFFN_MALLOC(str_length+1);
+    entry->key = (char*) TFFN_MALLOC(key_length + 1);
     TFFN_ASSERT(entry->key != NULL && "Couldn't allocate memory");
-    for(size_t i = 0; i < str_length; i++) {
-        entry->key[i] = key[i];
-    }
-    entry->key[str_length] = '\0';
-    entry->key_length = str_length;
+    memcpy(entry->key, key, key_length);
+    entry->key[key_length] = '\0';
+    entry->key_length = key_length;
+    entry->hash = __tffn_htable_hash(ht, key, key_length);
 
     // Insert new entry
-    size_t index = __tffn_htable_str_to_index(ht->table_size, key);
+    size_t index = entry->hash % ht->table_size;
     entry->next = ht->entries[index];
     ht->entries[index] = entry;
-}
+    ht->entry_count++;
 
+    size_t chain_length = 0;
+    for (__TFFNEntry* temp = entry; temp != NULL; temp = temp->next) chain_length++;
 
-// Internal helper function, not meant to be used by this library's users
-static void __tffn_fhtable_insert(__TFFNFuncHashTable* ht, const char* key, void(*func)(TFFNStrBuilder*)) {
-    TFFN_ASSERT(ht != NULL);
-    TFFN_ASSERT(key != NULL);
-    TFFN_ASSERT(func != NULL);
+    if(chain_length > TFFN_MAX_CHAIN_LENGTH && ht->mode == TFFN_HASH_FAST) {
+        __tffn_htable_rekey(ht, TFFN_HASH_KEYED);
+    }
+    else if(chain_length > TFFN_MAX_CHAIN_LENGTH || ht->entry_count > ht->table_size) {
+        __tffn_htable_resize(ht, ht->table_size * 2);
+    }
 
-    // Do nothing if the key already exists
-    size_t str_length = strlen(key);
-    if(__tffn_fhtable_lookup(ht, key) != NULL) return;
+    return entry;
+}
 
-    // Create new entry
-    __TFFNFuncEntry* entry = (__TFFNFuncEntry*) TFFN_MALLOC(sizeof(__TFFNFuncEntry));
-    TFFN_ASSERT(entry != NULL && "Couldn't allocate memory");
-    entry->func = func;
-    entry->key = (char*) TFFN_MALLOC(str_length + 1);
-    TFFN_ASSERT(entry->key != NULL && "Couldn't allocate memory");
-    for(size_t i = 0; i < str_length; i++) {
-        entry->key[i] = key[i];
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_actions_resize(__TFFNActionTable* table, uint32_t new_size) {
+    if(new_size <= table->table_size) return;
+
+    __TFFNAction** new_entries = (__TFFNAction**) TFFN_CALLOC(sizeof(__TFFNAction*), new_size);
+    TFFN_ASSERT(new_entries != NULL && "Couldn't allocate memory");
+
+    for (uint32_t i = 0; i < table->table_size; i++) {
+        __TFFNAction* temp = table->entries[i];
+        while(temp != NULL) {
+            __TFFNAction* next = temp->next;
+            size_t index = temp->hash % new_size;
+            temp->next = new_entries[index];
+            new_entries[index] = temp;
+            temp = next;
+        }
     }
-    entry->key[str_length] = '\0';
-    entry->key_length = str_length;
 
-    // Insert new entry
-    size_t index = __tffn_htable_str_to_index(ht->table_size, key);
-    entry->next = ht->entries[index];
-    ht->entries[index] = entry;
+    TFFN_FREE(table->entries);
+    table->entries = new_entries;
+    table->table_size = new_size;
 }
 
 
 // Internal helper function, not meant to be used by this library's users
-static int __tffn_parser_contains_act_text(TFFNParser* parser, char* act_text) {
-    void(*dynamic_obj)(TFFNStrBuilder*);
-    dynamic_obj = __tffn_fhtable_lookup(parser->dynamic_actions, act_text);
+// Finds the action named by the first act_text_length characters of act_text, act_text doesnt
+// need to be NULL terminated so this can be used directly on a format string
+static __TFFNAction* __tffn_actions_lookup(__TFFNActionTable* table, const char* act_text,
+        size_t act_text_length, uint64_t hash) {
+    __TFFNAction* temp = table->entries[hash % table->table_size];
+    while(temp != NULL) {
+        if(temp->hash == hash && temp->key_length == act_text_length
+                && memcmp(temp->key, act_text, act_text_length) == 0) break;
+        temp = temp->next;
+    }
+    return temp;
+}
 
-    void* static_obj = __tffn_htable_lookup(parser->static_actions, act_text);
-    
-    if(dynamic_obj != NULL || static_obj != NULL) {
-        tffn_sb_clear(parser->sb_err);
 
-        char buffer[512];
-        sprintf(buffer, "An action with '%s' name already exists!", act_text);
-        tffn_sb_append_nterm(parser->sb_err, buffer);
-        return 1;
+// Internal helper function, not meant to be used by this library's users
+// Links an already filled entry into the table, entry->hash must be set
+static void __tffn_actions_link(__TFFNActionTable* table, __TFFNAction* entry) {
+    size_t index = entry->hash % table->table_size;
+    entry->next = table->entries[index];
+    table->entries[index] = entry;
+    table->entry_count++;
+
+    if(table->entry_count > table->table_size) {
+        __tffn_actions_resize(table, table->table_size * 2);
     }
-    
-    return 0;
 }
 
 
 // Internal helper function, not meant to be used by this library's users
-static void __tffn_append_static_step(__TFFNStep** steps_head, char* static_str) {
-    __TFFNStep* s = (__TFFNStep*) TFFN_MALLOC(sizeof(__TFFNStep));
-    TFFN_ASSERT(s != NULL && "Couldn't allocate memory");
-    s->dynamic_step = NULL;
-    s->static_step = static_str;
-    s->next = NULL;
+static __TFFNActionTable* __tffn_actions_new(uint32_t table_size) {
+    __TFFNActionTable* table = (__TFFNActionTable*) TFFN_MALLOC(sizeof(__TFFNActionTable));
+    TFFN_ASSERT(table != NULL && "Couldn't allocate memory");
+
+    table->table_size = table_size;
+    table->entry_count = 0;
+    table->entries = (__TFFNAction**) TFFN_CALLOC(sizeof(__TFFNAction*), table_size);
+    TFFN_ASSERT(table->entries != NULL && "Couldn't allocate memory");
+    return table;
+}
 
-    if(*steps_head == NULL) { // Set as first element
-        *steps_head = s;
-    }
-    else { // Append to the end
-        __TFFNStep* last = *steps_head;
-        while(last->next != NULL) { last = last->next; }
-        last->next = s;
+
+// Internal helper function, not meant to be used by this library's users
+// Frees the table and every entry inside it, entries inside an arena are left to their arena
+static void __tffn_actions_free(__TFFNActionTable* table) {
+    if (table == NULL) return;
+
+    for (size_t i = 0; i < table->table_size; i++) {
+        __TFFNAction* temp = table->entries[i];
+        while (temp != NULL) {
+            __TFFNAction* next = temp->next;
+            tffn_sb_free(temp->memo);
+            TFFN_FREE(temp->dependents);
+            if(!temp->in_arena) {
+                TFFN_FREE(temp->key);
+                TFFN_FREE(temp);
+            }
+            temp = next;
+        }
     }
+
+    TFFN_FREE(table->entries);
+    TFFN_FREE(table);
 }
 
 
 // Internal helper function, not meant to be used by this library's users
-static void __tffn_append_dynamic_step(__TFFNStep** steps_head, void(*dynamic_act)(TFFNStrBuilder*)) {
-    __TFFNStep* s = (__TFFNStep*) TFFN_MALLOC(sizeof(__TFFNStep));
-    TFFN_ASSERT(s != NULL && "Couldn't allocate memory");
-    s->dynamic_step = dynamic_act;
-    s->static_step = NULL;
-    s->next = NULL;
+// splitmix64 finalizer, spreads every bit of x over the whole result
+static uint64_t __tffn_mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
 
-    if(*steps_head == NULL) { // Set as first element
-        *steps_head = s;
-    }
-    else { // Append to the end
-        __TFFNStep* last = *steps_head;
-        while(last->next != NULL) { last = last->next; }
-        last->next = s;
-    }
+
+// Internal helper function, not meant to be used by this library's users
+// Derives the bucket and the two slot hashes of a key from its (already computed) action hash
+static void __tffn_perfect_hashes(uint64_t hash, uint64_t seed, uint32_t bucket_count, uint32_t slot_count,
+        uint32_t* bucket, uint64_t* h1, uint64_t* h2) {
+    uint64_t g = __tffn_mix64(hash ^ seed);
+    *bucket = (uint32_t) ((g & 0xFFFFFFFFULL) % bucket_count);
+    *h1 = (g >> 32) % slot_count;
+    *h2 = __tffn_mix64(g) % slot_count;
 }
 
 
 // Internal helper function, not meant to be used by this library's users
-static __TFFNStep* __tffn_parse_steps(TFFNParser* parser, const char* format) {
-    tffn_sb_clear(parser->sb_part);
-    tffn_sb_clear(parser->sb_brack);
+// Perfect hash version of __tffn_actions_lookup
+static __TFFNAction* __tffn_perfect_lookup(const __TFFNPerfectHash* ph, const char* act_text,
+        size_t act_text_length, uint64_t hash) {
+    uint32_t bucket;
+    uint64_t h1, h2;
+    __tffn_perfect_hashes(hash, ph->seed, ph->bucket_count, ph->slot_count, &bucket, &h1, &h2);
+
+    uint64_t d0 = ph->displacements[2 * bucket], d1 = ph->displacements[2 * bucket + 1];
+    const __TFFNPerfectSlot* slot = &ph->slots[(h1 + d0 * h2 + d1) % ph->slot_count];
+
+    if(slot->hash == hash && slot->key_length == act_text_length
+            && memcmp(ph->keys + slot->key_offset, act_text, act_text_length) == 0) return slot->action;
+    return NULL;
+}
 
-    __TFFNStep* steps_head = NULL;
-    int format_len = strlen(format);
-    
-    bool in_brack = false;
 
-    int i = 0;
-    while(i < format_len) {
-        char c = format[i];
+// Internal helper function, not meant to be used by this library's users
+// Tries to place every action into its own slot with the given seed, the buckets are placed
+// biggest first and each of them searches for a displacement pair (d0, d1) that moves all of its
+// actions into free slots. Returns false if some bucket couldnt be placed
+static bool __tffn_perfect_place(__TFFNPerfectHash* ph, __TFFNAction** actions, uint32_t* order,
+        uint32_t* bucket_sizes, uint32_t* bucket_starts, uint32_t* members, uint64_t* h, uint32_t* candidate) {
+    const uint32_t MAX_D0 = 64; // every bucket gets MAX_D0 * slot_count tries
+    uint32_t n = ph->slot_count, r = ph->bucket_count;
+
+    memset(bucket_sizes, 0, sizeof(uint32_t) * (r + 1));
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t bucket;
+        __tffn_perfect_hashes(actions[i]->hash, ph->seed, r, n, &bucket, &h[2 * i], &h[2 * i + 1]);
+        bucket_sizes[bucket]++;
+        members[i] = bucket; // temporarily holds the bucket of every action
+    }
 
-        switch (c) {
-            case '[': {
-                if(in_brack) {
-                    tffn_sb_clear(parser->sb_err);
-                    tffn_sb_append_nterm(
-                        parser->sb_err, "INVALID FORMAT: nesting brackets are prohibited in TFFN"
-                    );
-                    return NULL;
+    // Group the actions by their buckets
+    bucket_starts[0] = 0;
+    for (uint32_t b = 0; b < r; b++) bucket_starts[b + 1] = bucket_starts[b] + bucket_sizes[b];
+    memcpy(order, bucket_starts, sizeof(uint32_t) * r); // order is used as a cursor per bucket for now
+    for (uint32_t i = 0; i < n; i++) candidate[order[members[i]]++] = i;
+    memcpy(members, candidate, sizeof(uint32_t) * n);
+
+    // Sort the buckets by their sizes (biggest ones first) with a counting sort, candidate is
+    // free again so it counts how many buckets are bigger than each size
+    uint32_t max_size = 0;
+    for (uint32_t b = 0; b < r; b++) if(bucket_sizes[b] > max_size) max_size = bucket_sizes[b];
+    memset(candidate, 0, sizeof(uint32_t) * (max_size + 1));
+    for (uint32_t b = 0; b < r; b++) candidate[bucket_sizes[b]]++;
+    uint32_t bigger = 0;
+    for (uint32_t size = max_size + 1; size-- > 0;) {
+        uint32_t count = candidate[size];
+        candidate[size] = bigger;
+        bigger += count;
+    }
+    for (uint32_t b = 0; b < r; b++) order[candidate[bucket_sizes[b]]++] = b;
+
+    for (uint32_t i = 0; i < n; i++) ph->slots[i].action = NULL;
+
+    for (uint32_t o = 0; o < r; o++) {
+        uint32_t b = order[o];
+        uint32_t size = bucket_sizes[b];
+        uint32_t* bucket_members = members + bucket_starts[b];
+        ph->displacements[2 * b] = 0;
+        ph->displacements[2 * b + 1] = 0;
+        if(size == 0) continue;
+
+        bool placed = false;
+        for (uint64_t d0 = 0; d0 < MAX_D0 && !placed; d0++) {
+            for (uint64_t d1 = 0; d1 < n && !placed; d1++) {
+                placed = true;
+                for (uint32_t k = 0; k < size && placed; k++) {
+                    uint32_t a = bucket_members[k];
+                    candidate[k] = (uint32_t) ((h[2 * a] + d0 * h[2 * a + 1] + d1) % n);
+                    if(ph->slots[candidate[k]].action != NULL) placed = false;
+                    for (uint32_t j = 0; j < k && placed; j++) {
+                        if(candidate[j] == candidate[k]) placed = false;
+                    }
                 }
 
-                in_brack = true;
-                i++;
-            } break;
-
-            case ']': {
-                if(!in_brack) {
-                    tffn_sb_clear(parser->sb_err);
-                    tffn_sb_append_nterm(
-                        parser->sb_err, "INVALID FORMAT: you forgot to open a bracket"
-                    );
-                    return NULL;
+                if(placed) {
+                    ph->displacements[2 * b] = (uint32_t) d0;
+                    ph->displacements[2 * b + 1] = (uint32_t) d1;
+                    for (uint32_t k = 0; k < size; k++) ph->slots[candidate[k]].action = actions[bucket_members[k]];
                 }
+            }
+        }
 
-                in_brack = false;
+        if(!placed) return false;
+    }
+
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Builds the perfect hash of every action inside the given table, returns NULL if the table is
+// empty or if no perfect hash could be found (two different names with the exact same 64 bit
+// hash for example), the chained table keeps working in that case
+static __TFFNPerfectHash* __tffn_perfect_build(__TFFNActionTable* table) {
+    const uint32_t MAX_SEEDS = 8;
+    uint32_t n = table->entry_count;
+    if(n == 0) return NULL;
+
+    __TFFNAction** actions = (__TFFNAction**) TFFN_MALLOC(sizeof(__TFFNAction*) * n);
+    TFFN_ASSERT(actions != NULL && "Couldn't allocate memory");
+    size_t key_bytes = 0;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < table->table_size; i++) {
+        for (__TFFNAction* temp = table->entries[i]; temp != NULL; temp = temp->next) {
+            actions[count++] = temp;
+            key_bytes += temp->key_length;
+        }
+    }
+
+    // Around 4 actions per bucket, this is what keeps the displacements small
+    uint32_t r = n / 4 + 1;
+    size_t header_size = (sizeof(__TFFNPerfectHash) + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    size_t total_size = header_size + sizeof(__TFFNPerfectSlot) * n + sizeof(uint32_t) * 2 * r + key_bytes;
+    __TFFNPerfectHash* ph = (__TFFNPerfectHash*) TFFN_MALLOC(total_size);
+    TFFN_ASSERT(ph != NULL && "Couldn't allocate memory");
+    ph->byte_size = total_size;
+    ph->slot_count = n;
+    ph->bucket_count = r;
+    ph->slots = (__TFFNPerfectSlot*) ((char*) ph + header_size);
+    ph->displacements = (uint32_t*) (ph->slots + n);
+    ph->keys = (char*) (ph->displacements + 2 * r);
+
+    // Scratch memory for the placement
+    uint32_t* order = (uint32_t*) TFFN_MALLOC(sizeof(uint32_t) * r);
+    uint32_t* bucket_sizes = (uint32_t*) TFFN_MALLOC(sizeof(uint32_t) * (r + 1));
+    uint32_t* bucket_starts = (uint32_t*) TFFN_MALLOC(sizeof(uint32_t) * (r + 1));
+    uint32_t* members = (uint32_t*) TFFN_MALLOC(sizeof(uint32_t) * n);
+    uint32_t* candidate = (uint32_t*) TFFN_MALLOC(sizeof(uint32_t) * (n + 1));
+    uint64_t* h = (uint64_t*) TFFN_MALLOC(sizeof(uint64_t) * 2 * n);
+    TFFN_ASSERT(order != NULL && bucket_sizes != NULL && bucket_starts != NULL && "Couldn't allocate memory");
+    TFFN_ASSERT(members != NULL && candidate != NULL && h != NULL && "Couldn't allocate memory");
+
+    bool placed = false;
+    for (uint32_t attempt = 0; attempt < MAX_SEEDS && !placed; attempt++) {
+        ph->seed = __tffn_mix64(0x9E3779B97F4A7C15ULL * (attempt + 1));
+        placed = __tffn_perfect_place(ph, actions, order, bucket_sizes, bucket_starts, members, h, candidate);
+    }
+
+    TFFN_FREE(order);
+    TFFN_FREE(bucket_sizes);
+    TFFN_FREE(bucket_starts);
+    TFFN_FREE(members);
+    TFFN_FREE(candidate);
+    TFFN_FREE(h);
+    TFFN_FREE(actions);
+
+    if(!placed) {
+        TFFN_FREE(ph);
+        return NULL;
+    }
+
+    // Pack the keys in slot order so neighbouring slots have neighbouring keys
+    uint32_t key_offset = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        __TFFNPerfectSlot* slot = &ph->slots[i];
+        slot->hash = slot->action->hash;
+        slot->key_offset = key_offset;
+        slot->key_length = (uint32_t) slot->action->key_length;
+        memcpy(ph->keys + key_offset, slot->action->key, slot->action->key_length);
+        key_offset += slot->key_length;
+    }
+
+    return ph;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Copies the given perfect hash and every action it points to into a single new allocation,
+// the copy is written by the calling thread so (with the usual first touch policy) its memory
+// ends up on the NUMA node of that thread. Copied actions share their keys and action texts
+// with the originals, their memo and dependents are never used since only children read them
+static __TFFNPerfectHash* __tffn_perfect_replicate(const __TFFNPerfectHash* ph) {
+    size_t actions_offset = (ph->byte_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    __TFFNPerfectHash* copy = (__TFFNPerfectHash*) TFFN_MALLOC(actions_offset + sizeof(__TFFNAction) * ph->slot_count);
+    TFFN_ASSERT(copy != NULL && "Couldn't allocate memory");
+
+    memcpy(copy, ph, ph->byte_size);
+    copy->slots = (__TFFNPerfectSlot*) ((char*) copy + ((const char*) ph->slots - (const char*) ph));
+    copy->displacements = (uint32_t*) ((char*) copy + ((const char*) ph->displacements - (const char*) ph));
+    copy->keys = (char*) copy + (ph->keys - (const char*) ph);
+
+    __TFFNAction* actions = (__TFFNAction*) ((char*) copy + actions_offset);
+    for (uint32_t i = 0; i < copy->slot_count; i++) {
+        actions[i] = *copy->slots[i].action;
+        actions[i].memo = NULL;
+        actions[i].dependents = NULL;
+        actions[i].dependent_count = 0;
+        actions[i].dependent_capacity = 0;
+        actions[i].next = NULL;
+        copy->slots[i].action = &actions[i];
+    }
+
+    return copy;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Looks the action up in the parser itself first and then in its bases (see tffn_parser_new_child)
+// *inherited is set to true if the returned action belongs to one of the bases, every parser
+// hashes action names the same way so a single hash is enough for all of them
+static __TFFNAction* __tffn_parser_lookup_action(TFFNParser* parser, const char* act_text,
+        size_t act_text_length, uint64_t hash, bool* inherited) {
+    *inherited = false;
+    for (TFFNParser* layer = parser; layer != NULL; layer = layer->base) {
+        __TFFNAction* action = NULL;
+        __TFFNPerfectHash* ph = layer->perfect_hash;
+        __TFFNPerfectHash* replica = layer != parser ? __tffn_atomic_load(&layer->replicas[parser->numa_node]) : NULL;
+        if(replica != NULL) ph = replica;
+        if(ph != NULL) action = __tffn_perfect_lookup(ph, act_text, act_text_length, hash);
+        else action = __tffn_actions_lookup(layer->actions, act_text, act_text_length, hash);
+        if(action != NULL) return action;
+        *inherited = true;
+    }
+    return NULL;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Stores an error without building any message, see tffn_parser_err_msg for that
+static void __tffn_parser_set_error(TFFNParser* parser, TFFNErrorCode code, size_t offset,
+        size_t span_offset, size_t span_length) {
+    parser->err.code = code;
+    parser->err.offset = offset;
+    parser->err.span_offset = span_offset;
+    parser->err.span_length = span_length;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Stores an error whose offending text is the given action name, the name is copied into sb_err
+// since the user is free to get rid of it as soon as the function that failed returns
+static void __tffn_parser_set_name_error(TFFNParser* parser, TFFNErrorCode code,
+        const char* act_text, size_t act_text_length) {
+    tffn_sb_clear(parser->sb_err);
+    tffn_sb_append_sized(parser->sb_err, act_text, act_text_length);
+    parser->err_text = parser->sb_err->buffer;
+    __tffn_parser_set_error(parser, code, 0, 0, act_text_length);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_parser_clear_error(TFFNParser* parser) {
+    __tffn_parser_set_error(parser, TFFN_OK, 0, 0, 0);
+    parser->err_text = NULL;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns a new heap allocated entry for act_text (which doesnt need to be NULL terminated) that
+// isnt linked into any table yet, only its action needs to be set
+static __TFFNAction* __tffn_action_new(const char* act_text, size_t act_text_length, uint64_t hash) {
+    __TFFNAction* entry = (__TFFNAction*) TFFN_MALLOC(sizeof(__TFFNAction));
+    TFFN_ASSERT(entry != NULL && "Couldn't allocate memory");
+    entry->key = (char*) TFFN_MALLOC(act_text_length + 1);
+    TFFN_ASSERT(entry->key != NULL && "Couldn't allocate memory");
+    memcpy(entry->key, act_text, act_text_length);
+    entry->key[act_text_length] = '\0';
+    entry->key_length = act_text_length;
+    entry->hash = hash;
+    entry->static_act = NULL;
+    entry->static_act_length = 0;
+    entry->dynamic_act = NULL;
+    entry->param_act = NULL;
+    entry->async_act = NULL;
+    entry->policy = TFFN_ACTION_VOLATILE;
+    entry->parallel = false;
+    entry->escape = TFFN_ESCAPE_DEFAULT;
+    entry->memo = NULL;
+    entry->memo_epoch = 0;
+    entry->dependents = NULL;
+    entry->dependent_count = 0;
+    entry->dependent_capacity = 0;
+    entry->in_arena = false;
+    return entry;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Same as __tffn_action_new but the entry is already linked into parser->actions, no checks are made
+static __TFFNAction* __tffn_parser_alloc_action(TFFNParser* parser, const char* act_text,
+        size_t act_text_length, uint64_t hash) {
+    __TFFNAction* entry = __tffn_action_new(act_text, act_text_length, hash);
+    __tffn_actions_link(parser->actions, entry);
+    return entry;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true if the actions of the given parser cant change anymore, either because it got
+// frozen by tffn_parser_freeze or because it is the base of other parsers
+// Its derived from ref_count alone so creating and freeing children on other threads cant
+// leave a stale answer behind, a base with a live child is always seen as frozen
+static bool __tffn_parser_frozen(TFFNParser* parser) {
+    return parser->frozen_for_good || __tffn_atomic_load(&parser->ref_count) > 1;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Same as __tffn_parser_alloc_action but returns NULL if the parser is frozen (a
+// TFFN_ERR_FROZEN_PARSER error is stored) or if an action with the same name already exists
+// in the parser or in one of its bases (a TFFN_ERR_DUPLICATE_ACTION error is stored)
+static __TFFNAction* __tffn_parser_new_action(TFFNParser* parser, const char* act_text, size_t act_text_length) {
+    if(__tffn_parser_frozen(parser)) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_FROZEN_PARSER, act_text, act_text_length);
+        return NULL;
+    }
+
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    bool inherited;
+    if(__tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited) != NULL) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_DUPLICATE_ACTION, act_text, act_text_length);
+        return NULL;
+    }
+
+    __TFFNAction* entry = __tffn_parser_alloc_action(parser, act_text, act_text_length, hash);
+    parser->action_generation++;
+    return entry;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Pure and epoch actions keep their memoized output inside their entry, so the ones that belong
+// to a base are copied into the parser the first time it uses them. This way the base is
+// never written to and every parser memoizes (and counts its epochs) on its own
+// The copies live in parser->adopted instead of parser->actions: the parser can be the base of
+// children that look its actions up from other threads, and they adopt their own copies anyway
+static __TFFNAction* __tffn_parser_adopt_action(TFFNParser* parser, __TFFNAction* action, bool inherited) {
+    if(!inherited || action->kind != __TFFN_ACTION_DYNAMIC || action->policy == TFFN_ACTION_VOLATILE) {
+        return action;
+    }
+
+    if(parser->adopted == NULL) parser->adopted = __tffn_actions_new(16);
+    __TFFNAction* copy = __tffn_actions_lookup(parser->adopted, action->key, action->key_length, action->hash);
+    if(copy != NULL) return copy;
+
+    copy = __tffn_action_new(action->key, action->key_length, action->hash);
+    __tffn_actions_link(parser->adopted, copy);
+    copy->kind = action->kind;
+    copy->dynamic_act = action->dynamic_act;
+    copy->policy = action->policy;
+    copy->parallel = action->parallel;
+    copy->escape = action->escape;
+    return copy;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_append_static_step(__TFFNStep** steps_head, const char* static_str, size_t static_length) {
+    __TFFNStep* s = (__TFFNStep*) TFFN_MALLOC(sizeof(__TFFNStep));
+    TFFN_ASSERT(s != NULL && "Couldn't allocate memory");
+    s->kind = __TFFN_STEP_STATIC;
+    s->dynamic_step = NULL;
+    s->static_step = static_str;
+    s->static_length = static_length;
+    s->args = NULL;
+    s->arg_count = 0;
+    s->slot = 0;
+    s->escape = TFFN_ESCAPE_DEFAULT;
+    s->next = NULL;
+
+    if(*steps_head == NULL) { // Set as first element
+        *steps_head = s;
+    }
+    else { // Append to the end
+        __TFFNStep* last = *steps_head;
+        while(last->next != NULL) { last = last->next; }
+        last->next = s;
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_append_dynamic_step(__TFFNStep** steps_head, __TFFNAction* dynamic_act,
+        TFFNArg* args, size_t arg_count, TFFNEscape escape) {
+    __TFFNStep* s = (__TFFNStep*) TFFN_MALLOC(sizeof(__TFFNStep));
+    TFFN_ASSERT(s != NULL && "Couldn't allocate memory");
+    s->kind = __TFFN_STEP_DYNAMIC;
+    s->dynamic_step = dynamic_act;
+    s->static_step = NULL;
+    s->static_length = 0;
+    s->args = args;
+    s->arg_count = arg_count;
+    s->slot = 0;
+    s->escape = escape;
+    s->next = NULL;
+
+    if(*steps_head == NULL) { // Set as first element
+        *steps_head = s;
+    }
+    else { // Append to the end
+        __TFFNStep* last = *steps_head;
+        while(last->next != NULL) { last = last->next; }
+        last->next = s;
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_append_slot_step(__TFFNStep** steps_head, size_t slot, TFFNEscape escape) {
+    __TFFNStep* s = (__TFFNStep*) TFFN_MALLOC(sizeof(__TFFNStep));
+    TFFN_ASSERT(s != NULL && "Couldn't allocate memory");
+    s->kind = __TFFN_STEP_SLOT;
+    s->dynamic_step = NULL;
+    s->static_step = NULL;
+    s->static_length = 0;
+    s->args = NULL;
+    s->arg_count = 0;
+    s->slot = slot;
+    s->escape = escape;
+    s->next = NULL;
+
+    if(*steps_head == NULL) { // Set as first element
+        *steps_head = s;
+    }
+    else { // Append to the end
+        __TFFNStep* last = *steps_head;
+        while(last->next != NULL) { last = last->next; }
+        last->next = s;
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true if the bracket text is a value slot like "$0" or "$12" and stores its index
+static bool __tffn_parse_slot(const char* brack_content, size_t brack_length, size_t* slot) {
+    if(brack_length < 2 || brack_content[0] != '$') return false;
+
+    size_t index = 0;
+    for (size_t i = 1; i < brack_length; i++) {
+        char c = brack_content[i];
+        if(c < '0' || c > '9') return false;
+        if(index > (SIZE_MAX - 9) / 10) return false; // would overflow
+        index = index * 10 + (size_t) (c - '0');
+    }
+
+    *slot = index;
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_action_list_push(__TFFNActionList* list, __TFFNAction* action) {
+    if(list->count == list->capacity) {
+        list->capacity = (list->capacity == 0) ? 8 : list->capacity * 2;
+        list->items = (__TFFNAction**) TFFN_REALLOC(list->items, list->capacity * sizeof(__TFFNAction*));
+        TFFN_ASSERT(list->items != NULL && "Couldn't allocate memory");
+    }
+    list->items[list->count++] = action;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Records that the given template folded the given static action into its steps
+static void __tffn_action_add_dependent(__TFFNAction* action, __TFFNTemplate* tmpl) {
+    // A template is registered right after it gets compiled, so if it uses the same action
+    // more than once it will always be the last dependent
+    if(action->dependent_count > 0 && action->dependents[action->dependent_count - 1] == tmpl) return;
+
+    if(action->dependent_count == action->dependent_capacity) {
+        action->dependent_capacity = (action->dependent_capacity == 0) ? 4 : action->dependent_capacity * 2;
+        action->dependents = (__TFFNTemplate**) TFFN_REALLOC(
+            action->dependents, action->dependent_capacity * sizeof(__TFFNTemplate*)
+        );
+        TFFN_ASSERT(action->dependents != NULL && "Couldn't allocate memory");
+    }
+    action->dependents[action->dependent_count++] = tmpl;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Finds the action of a bracket, if the whole bracket text isnt an action but it has a ':'
+// in it, the text before the ':' is looked up instead and *args_text is set to the text after it
+// *args_text is set to NULL if the bracket has no arguments, *inherited is set like
+// __tffn_parser_lookup_action sets it
+static __TFFNAction* __tffn_parser_resolve_bracket(TFFNParser* parser, const char* brack_content,
+        size_t brack_length, const char** args_text, size_t* args_length, bool* inherited) {
+    *args_text = NULL;
+    *args_length = 0;
+
+    uint64_t hash = __tffn_hash_sized(brack_content, brack_length);
+    __TFFNAction* action = __tffn_parser_lookup_action(parser, brack_content, brack_length, hash, inherited);
+    if(action != NULL) return action;
+
+    const char* colon = (const char*) memchr(brack_content, ':', brack_length);
+    if(colon == NULL) return NULL;
+
+    size_t name_length = colon - brack_content;
+    hash = __tffn_hash_sized(brack_content, name_length);
+    action = __tffn_parser_lookup_action(parser, brack_content, name_length, hash, inherited);
+    if(action == NULL) return NULL;
+
+    *args_text = colon + 1;
+    *args_length = brack_length - name_length - 1;
+    return action;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Splits the argument text of a bracket by ',' into a single allocation that holds
+// the TFFNArg array followed by all of the NULL terminated argument strings
+static TFFNArg* __tffn_split_args(const char* args_text, size_t args_length, size_t* arg_count) {
+    size_t count = 1;
+    for (size_t i = 0; i < args_length; i++) {
+        if(args_text[i] == ',') count++;
+    }
+
+    // Every ',' becomes a '\0' so the strings need exactly args_length + 1 bytes
+    TFFNArg* args = (TFFNArg*) TFFN_MALLOC(count * sizeof(TFFNArg) + args_length + 1);
+    TFFN_ASSERT(args != NULL && "Couldn't allocate memory");
+    char* strs = (char*) (args + count);
+    memcpy(strs, args_text, args_length);
+    strs[args_length] = '\0';
+
+    size_t arg_index = 0;
+    size_t arg_start = 0;
+    for (size_t i = 0; i <= args_length; i++) {
+        if(i == args_length || strs[i] == ',') {
+            strs[i] = '\0';
+            args[arg_index].str = strs + arg_start;
+            args[arg_index].length = i - arg_start;
+            arg_index++;
+            arg_start = i + 1;
+        }
+    }
+
+    *arg_count = count;
+    return args;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static __TFFNStringPool* __tffn_strings_new(const uint64_t key[2]) {
+    __TFFNStringPool* strings = (__TFFNStringPool*) TFFN_MALLOC(sizeof(__TFFNStringPool));
+    TFFN_ASSERT(strings != NULL && "Couldn't allocate memory");
+    strings->bucket_count = 256;
+    strings->string_count = 0;
+    strings->buckets = (__TFFNPooledString**) TFFN_CALLOC(strings->bucket_count, sizeof(__TFFNPooledString*));
+    TFFN_ASSERT(strings->buckets != NULL && "Couldn't allocate memory");
+    strings->key[0] = key[0];
+    strings->key[1] = key[1];
+    strings->slabs = NULL;
+    return strings;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Every string of the pool has to be released before this is called
+static void __tffn_strings_free(__TFFNStringPool* strings) {
+    if(strings == NULL) return;
+
+    while(strings->slabs != NULL) {
+        __TFFNStringSlab* next = strings->slabs->next;
+        TFFN_FREE(strings->slabs);
+        strings->slabs = next;
+    }
+    TFFN_FREE(strings->buckets);
+    TFFN_FREE(strings);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Headers of slabs and strings are rounded up with this so the headers after them stay aligned
+static size_t __tffn_strings_align(size_t size) {
+    return (size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static __TFFNPooledString* __tffn_strings_block(__TFFNStringSlab* slab, size_t offset) {
+    return (__TFFNPooledString*) ((char*) slab + __tffn_strings_align(sizeof(__TFFNStringSlab)) + offset);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Bytes of the block that holds a string of the given length, a block for length 0 is the smallest one
+static size_t __tffn_strings_block_size(size_t length) {
+    return __tffn_strings_align(sizeof(__TFFNPooledString) + length + 1);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Looks for size bytes in the free blocks of slab and merges free blocks that are next to each other
+// on the way, free blocks at the end of the slab go back to its unused part
+static __TFFNPooledString* __tffn_strings_reuse(__TFFNStringSlab* slab, size_t size) {
+    size_t largest = 0;
+    size_t offset = 0;
+    while(offset < slab->used) {
+        __TFFNPooledString* block = __tffn_strings_block(slab, offset);
+        if(block->ref_count > 0) {
+            offset += block->size;
+            continue;
+        }
+
+        size_t run = block->size;
+        while(offset + run < slab->used && __tffn_strings_block(slab, offset + run)->ref_count == 0) {
+            run += __tffn_strings_block(slab, offset + run)->size;
+        }
+        block->size = run;
+
+        if(offset + run == slab->used) {
+            slab->used = offset;
+            slab->free_bytes -= run;
+            break;
+        }
+
+        if(run >= size) {
+            // The rest stays a free block if a header fits into it
+            if(run - size >= __tffn_strings_block_size(0)) {
+                __TFFNPooledString* rest = __tffn_strings_block(slab, offset + size);
+                rest->slab = slab;
+                rest->size = run - size;
+                rest->ref_count = 0;
+                block->size = size;
+            }
+            slab->free_bytes -= block->size;
+            slab->live_count++;
+            return block;
+        }
+
+        if(run > largest) largest = run;
+        offset += run;
+    }
+
+    slab->fit_hint = largest;
+    return NULL;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Takes size bytes from the unused end of slab, returns NULL if they dont fit
+static __TFFNPooledString* __tffn_strings_bump(__TFFNStringSlab* slab, size_t size) {
+    if(slab->capacity - slab->used < size) return NULL;
+
+    __TFFNPooledString* block = __tffn_strings_block(slab, slab->used);
+    block->slab = slab;
+    block->size = size;
+    slab->used += size;
+    slab->live_count++;
+    return block;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns a block of at least size bytes (block->size tells how many). The current slab is filled
+// up first, then the free blocks of every slab are reused and only then a new slab is made
+// Strings that would take up a big part of a normal slab get a slab of their own, linked behind
+// the current one so the current one keeps filling up. Evacuated slabs are never used
+static __TFFNPooledString* __tffn_strings_alloc(__TFFNStringPool* strings, size_t size) {
+    __TFFNStringSlab* current = strings->slabs;
+    bool own_slab = size > TFFN_STRING_SLAB_SIZE / 4;
+
+    if(!own_slab) {
+        __TFFNPooledString* block = NULL;
+        if(current != NULL && !current->evacuate) block = __tffn_strings_bump(current, size);
+
+        for (__TFFNStringSlab* slab = current; slab != NULL && block == NULL; slab = slab->next) {
+            if(slab->evacuate) continue;
+            if(slab->fit_hint >= size) block = __tffn_strings_reuse(slab, size);
+            if(block == NULL) block = __tffn_strings_bump(slab, size);
+        }
+        if(block != NULL) return block;
+    }
+
+    size_t capacity = own_slab ? size : TFFN_STRING_SLAB_SIZE;
+    __TFFNStringSlab* slab = (__TFFNStringSlab*) TFFN_MALLOC(__tffn_strings_align(sizeof(__TFFNStringSlab)) + capacity);
+    TFFN_ASSERT(slab != NULL && "Couldn't allocate memory");
+    slab->owner = strings;
+    slab->capacity = capacity;
+    slab->used = 0;
+    slab->live_count = 0;
+    slab->free_bytes = 0;
+    slab->fit_hint = 0;
+    slab->evacuate = false;
+
+    if(own_slab && current != NULL) {
+        slab->prev = current;
+        slab->next = current->next;
+        if(current->next != NULL) current->next->prev = slab;
+        current->next = slab;
+    }
+    else {
+        slab->prev = NULL;
+        slab->next = current;
+        if(current != NULL) current->prev = slab;
+        strings->slabs = slab;
+    }
+
+    __TFFNPooledString* block = __tffn_strings_block(slab, 0);
+    block->slab = slab;
+    block->size = size;
+    slab->used = size;
+    slab->live_count = 1;
+    return block;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the interned copy of str, which is NULL terminated and stays valid until every
+// reference to it is given back with __tffn_strings_release
+static const char* __tffn_strings_intern(__TFFNStringPool* strings, const char* str, size_t length) {
+    uint64_t hash = __tffn_siphash13(str, length, strings->key[0], strings->key[1]);
+    __TFFNPooledString** bucket = &strings->buckets[hash & (strings->bucket_count - 1)];
+
+    for (__TFFNPooledString* entry = *bucket; entry != NULL; entry = entry->next) {
+        const char* text = (const char*) (entry + 1);
+        if(entry->hash == hash && entry->length == length && memcmp(text, str, length) == 0) {
+            entry->ref_count++;
+            return text;
+        }
+    }
+
+    __TFFNPooledString* entry = __tffn_strings_alloc(strings, __tffn_strings_block_size(length));
+    char* text = (char*) (entry + 1);
+    memcpy(text, str, length);
+    text[length] = '\0';
+    entry->hash = hash;
+    entry->length = length;
+    entry->ref_count = 1;
+    entry->pinned = false;
+    entry->next = *bucket;
+    *bucket = entry;
+
+    // Keep the chains short, the stored hashes make growing cheap
+    if(++strings->string_count > strings->bucket_count) {
+        uint32_t bucket_count = strings->bucket_count * 2;
+        __TFFNPooledString** buckets = (__TFFNPooledString**) TFFN_CALLOC(bucket_count, sizeof(__TFFNPooledString*));
+        TFFN_ASSERT(buckets != NULL && "Couldn't allocate memory");
+        for (uint32_t i = 0; i < strings->bucket_count; i++) {
+            __TFFNPooledString* temp = strings->buckets[i];
+            while(temp != NULL) {
+                __TFFNPooledString* next = temp->next;
+                temp->next = buckets[temp->hash & (bucket_count - 1)];
+                buckets[temp->hash & (bucket_count - 1)] = temp;
+                temp = next;
+            }
+        }
+        TFFN_FREE(strings->buckets);
+        strings->buckets = buckets;
+        strings->bucket_count = bucket_count;
+    }
+
+    return text;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Gives back a reference that __tffn_strings_intern returned, the string becomes a free block
+// once nothing uses it anymore and its slab is freed once all of its strings are gone
+static void __tffn_strings_release(const char* text) {
+    __TFFNPooledString* entry = ((__TFFNPooledString*) text) - 1;
+    if(--entry->ref_count > 0) return;
+
+    __TFFNStringSlab* slab = entry->slab;
+    __TFFNStringPool* strings = slab->owner;
+    __TFFNPooledString** link = &strings->buckets[entry->hash & (strings->bucket_count - 1)];
+    while(*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    strings->string_count--;
+
+    if(--slab->live_count > 0) {
+        if(entry == __tffn_strings_block(slab, slab->used - entry->size)) {
+            slab->used -= entry->size; // the last block goes straight back to the unused part
+        }
+        else {
+            slab->free_bytes += entry->size;
+            slab->fit_hint += entry->size; // it may merge with the free blocks around it
+        }
+        return;
+    }
+
+    if(slab == strings->slabs) { // the current slab gets filled up again from its start
+        slab->used = 0;
+        slab->free_bytes = 0;
+        slab->fit_hint = 0;
+        return;
+    }
+
+    slab->prev->next = slab->next;
+    if(slab->next != NULL) slab->next->prev = slab->prev;
+    TFFN_FREE(slab);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true if more than one static step uses the given interned string
+static bool __tffn_strings_shared(const char* text) {
+    return (((const __TFFNPooledString*) text) - 1)->ref_count > 1;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_steps_free(__TFFNStep* steps) {
+
+    while(steps != NULL) {
+        __TFFNStep* next = steps->next;
+        if(steps->kind == __TFFN_STEP_STATIC && steps->static_step != NULL) { // NULL if it is compressed
+            __tffn_strings_release(steps->static_step);
+        }
+        TFFN_FREE(steps->args); // the argument strings live in the same allocation
+        TFFN_FREE(steps);
+        steps = next;
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Gets rid of the current steps of a template that is about to get new ones, pinned templates
+// keep them around since an asynchronous render might be in the middle of them
+static void __tffn_template_retire_steps(__TFFNTemplate* tmpl) {
+    if(tmpl->pin_count == 0) {
+        __tffn_steps_free(tmpl->steps);
+        return;
+    }
+
+    __TFFNRetiredSteps* retired = (__TFFNRetiredSteps*) TFFN_MALLOC(sizeof(__TFFNRetiredSteps));
+    TFFN_ASSERT(retired != NULL && "Couldn't allocate memory");
+    retired->steps = tmpl->steps;
+    retired->next = tmpl->retired;
+    tmpl->retired = retired;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Frees every retired step list of the given template
+static void __tffn_template_free_retired(__TFFNTemplate* tmpl) {
+    while(tmpl->retired != NULL) {
+        __TFFNRetiredSteps* next = tmpl->retired->next;
+        __tffn_steps_free(tmpl->retired->steps);
+        TFFN_FREE(tmpl->retired);
+        tmpl->retired = next;
+    }
+}
+
+
+// ------------------------------------------------------------ //
+// Cold formats, see tffn_parser_compress_cold
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the most bytes that __tffn_lz_compress can write for length input bytes
+static size_t __tffn_lz_bound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Writes a literal or match length that didnt fit into its 4 bits of the token, LZ4 style
+static size_t __tffn_lz_write_length(unsigned char* dst, size_t length) {
+    size_t written = 0;
+    while(length >= 255) {
+        dst[written++] = 255;
+        length -= 255;
+    }
+    dst[written++] = (unsigned char) length;
+    return written;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Compresses src into dst (which must fit __tffn_lz_bound(length) bytes) and returns the compressed size
+// The format is the LZ4 block format: a token with the literal and match lengths, the literals,
+// a 2 byte offset of the match and the match length extensions, the last sequence has no match
+static size_t __tffn_lz_compress(const char* src, size_t length, char* dst) {
+    enum { HASH_BITS = 12 };
+    uint32_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    const unsigned char* in = (const unsigned char*) src;
+    unsigned char* out = (unsigned char*) dst;
+    size_t op = 0, ip = 0, anchor = 0;
+
+    while(ip + 4 <= length) {
+        uint32_t sequence;
+        memcpy(&sequence, in + ip, 4);
+        uint32_t h = (sequence * 2654435761U) >> (32 - HASH_BITS);
+        size_t ref = table[h];
+        table[h] = (uint32_t) ip;
+
+        if(ref >= ip || ip - ref > 65535 || memcmp(in + ref, in + ip, 4) != 0) {
+            ip++;
+            continue;
+        }
+
+        size_t match_length = 4;
+        while(ip + match_length < length && in[ref + match_length] == in[ip + match_length]) match_length++;
+
+        size_t literal_length = ip - anchor;
+        unsigned char* token = &out[op++];
+        *token = (unsigned char) (((literal_length < 15) ? literal_length : 15) << 4);
+        if(literal_length >= 15) op += __tffn_lz_write_length(out + op, literal_length - 15);
+        memcpy(out + op, in + anchor, literal_length);
+        op += literal_length;
+
+        size_t offset = ip - ref;
+        out[op++] = (unsigned char) (offset & 255);
+        out[op++] = (unsigned char) (offset >> 8);
+        *token |= (unsigned char) ((match_length - 4 < 15) ? match_length - 4 : 15);
+        if(match_length - 4 >= 15) op += __tffn_lz_write_length(out + op, match_length - 4 - 15);
+
+        ip += match_length;
+        anchor = ip;
+    }
+
+    size_t literal_length = length - anchor;
+    out[op++] = (unsigned char) (((literal_length < 15) ? literal_length : 15) << 4);
+    if(literal_length >= 15) op += __tffn_lz_write_length(out + op, literal_length - 15);
+    memcpy(out + op, in + anchor, literal_length);
+    return op + literal_length;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Decompresses what __tffn_lz_compress wrote into dst, which has to fit the original length
+static void __tffn_lz_decompress(const char* src, size_t packed_length, char* dst) {
+    const unsigned char* in = (const unsigned char*) src;
+    unsigned char* out = (unsigned char*) dst;
+    size_t ip = 0, op = 0;
+
+    while(ip < packed_length) {
+        unsigned char token = in[ip++];
+
+        size_t literal_length = token >> 4;
+        if(literal_length == 15) {
+            unsigned char b;
+            do { b = in[ip++]; literal_length += b; } while(b == 255);
+        }
+        memcpy(out + op, in + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if(ip >= packed_length) break; // the last sequence doesnt have a match
+
+        size_t offset = in[ip] | ((size_t) in[ip + 1] << 8);
+        ip += 2;
+        size_t match_length = (token & 15) + 4;
+        if((token & 15) == 15) {
+            unsigned char b;
+            do { b = in[ip++]; match_length += b; } while(b == 255);
+        }
+
+        // Matches can overlap the bytes they produce, so they are copied one byte at a time
+        for (size_t i = 0; i < match_length; i++, op++) out[op] = out[op - offset];
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Compresses the static text that only tmpl uses and gives it back to the string pool, text that
+// other formats share stays in the pool. Returns false if that wouldnt save enough memory or
+// if a view of tffn_parser_render_view may point into the text
+static bool __tffn_template_freeze(TFFNParser* parser, __TFFNTemplate* tmpl) {
+    size_t raw_length = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) {
+        if(step->kind != __TFFN_STEP_STATIC) continue;
+        if((((const __TFFNPooledString*) step->static_step) - 1)->pinned) return false; // a view may point to it
+        if(!__tffn_strings_shared(step->static_step)) raw_length += step->static_length;
+    }
+    if(raw_length < TFFN_MIN_COLD_BYTES) return false;
+
+    tffn_sb_clear(parser->sb_part);
+    char* raw = tffn_sb_reserve(parser->sb_part, raw_length + __tffn_lz_bound(raw_length));
+    size_t offset = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) {
+        if(step->kind != __TFFN_STEP_STATIC || __tffn_strings_shared(step->static_step)) continue;
+        memcpy(raw + offset, step->static_step, step->static_length);
+        offset += step->static_length;
+    }
+
+    char* packed = raw + raw_length;
+    size_t packed_length = __tffn_lz_compress(raw, raw_length, packed);
+    if(packed_length + sizeof(__TFFNColdText) >= raw_length) return false;
+
+    __TFFNColdText* cold = (__TFFNColdText*) TFFN_MALLOC(sizeof(__TFFNColdText) + packed_length);
+    TFFN_ASSERT(cold != NULL && "Couldn't allocate memory");
+    cold->raw_length = raw_length;
+    cold->packed_length = packed_length;
+    memcpy(cold + 1, packed, packed_length);
+
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) {
+        if(step->kind != __TFFN_STEP_STATIC || __tffn_strings_shared(step->static_step)) continue;
+        __tffn_strings_release(step->static_step);
+        step->static_step = NULL;
+    }
+    tmpl->cold = cold;
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Brings a compressed template back into the hot tier, see __tffn_template_freeze
+static void __tffn_template_thaw(TFFNParser* parser, __TFFNTemplate* tmpl) {
+    __TFFNColdText* cold = tmpl->cold;
+    tffn_sb_clear(parser->sb_part);
+    char* raw = tffn_sb_reserve(parser->sb_part, cold->raw_length);
+    __tffn_lz_decompress((const char*) (cold + 1), cold->packed_length, raw);
+
+    size_t offset = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) {
+        if(step->kind != __TFFN_STEP_STATIC || step->static_step != NULL) continue;
+        step->static_step = __tffn_strings_intern(parser->strings, raw + offset, step->static_length);
+        offset += step->static_length;
+    }
+
+    TFFN_FREE(cold);
+    tmpl->cold = NULL;
+}
+
+
+// ------------------------------------------------------------ //
+// Worker pool, only compiled when TFFN_ENABLE_THREADS is defined before including the header file
+
+#ifdef TFFN_ENABLE_THREADS
+
+#ifdef _WIN32
+    typedef CRITICAL_SECTION __tffn_mutex_t;
+    typedef CONDITION_VARIABLE __tffn_cond_t;
+    typedef HANDLE __tffn_thread_t;
+    #define __tffn_mutex_init(m) InitializeCriticalSection((m))
+    #define __tffn_mutex_destroy(m) DeleteCriticalSection((m))
+    #define __tffn_mutex_lock(m) EnterCriticalSection((m))
+    #define __tffn_mutex_unlock(m) LeaveCriticalSection((m))
+    #define __tffn_cond_init(c) InitializeConditionVariable((c))
+    #define __tffn_cond_destroy(c) ((void) (c))
+    #define __tffn_cond_wait(c, m) SleepConditionVariableCS((c), (m), INFINITE)
+    #define __tffn_cond_broadcast(c) WakeAllConditionVariable((c))
+#else
+    typedef pthread_mutex_t __tffn_mutex_t;
+    typedef pthread_cond_t __tffn_cond_t;
+    typedef pthread_t __tffn_thread_t;
+    #define __tffn_mutex_init(m) pthread_mutex_init((m), NULL)
+    #define __tffn_mutex_destroy(m) pthread_mutex_destroy((m))
+    #define __tffn_mutex_lock(m) pthread_mutex_lock((m))
+    #define __tffn_mutex_unlock(m) pthread_mutex_unlock((m))
+    #define __tffn_cond_init(c) pthread_cond_init((c), NULL)
+    #define __tffn_cond_destroy(c) pthread_cond_destroy((c))
+    #define __tffn_cond_wait(c, m) pthread_cond_wait((c), (m))
+    #define __tffn_cond_broadcast(c) pthread_cond_broadcast((c))
+#endif
+
+// One parallel action of the render that is running right now
+typedef struct _TFFNParallelTask {
+    __TFFNStep* step;
+    TFFNStrBuilder* sb;  // output of the action, appended in step order once every task is done
+} __TFFNParallelTask;
+
+typedef struct _TFFNWorkerPool {
+    __tffn_mutex_t lock;
+    __tffn_cond_t work_ready;       // a batch got submitted or the pool is stopping
+    __tffn_cond_t work_done;        // the last task of the batch finished
+    __tffn_thread_t* threads;
+    size_t thread_count;
+    __TFFNParallelTask* tasks;      // tasks of the current batch, reused between renders
+    size_t task_capacity;
+    size_t task_count;
+    size_t next_task;               // first task that no thread took yet
+    size_t finished_tasks;
+    bool stopping;
+} __TFFNWorkerPool;
+
+
+// Internal helper function, not meant to be used by this library's users
+// Runs tasks of the current batch until none are left, pool->lock must be held and is held again on return
+static void __tffn_pool_work(__TFFNWorkerPool* pool) {
+    while(pool->next_task < pool->task_count) {
+        __TFFNParallelTask* task = &pool->tasks[pool->next_task++];
+        __tffn_mutex_unlock(&pool->lock);
+
+        // Only volatile dynamic and parameterized actions get here, they dont touch the parser
+        __TFFNStep* step = task->step;
+        if(step->dynamic_step->kind == __TFFN_ACTION_PARAM) {
+            step->dynamic_step->param_act(task->sb, step->args, step->arg_count);
+        }
+        else {
+            step->dynamic_step->dynamic_act(task->sb);
+        }
+
+        __tffn_mutex_lock(&pool->lock);
+        pool->finished_tasks++;
+        if(pool->finished_tasks == pool->task_count) __tffn_cond_broadcast(&pool->work_done);
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+#ifdef _WIN32
+static DWORD WINAPI __tffn_pool_worker(LPVOID arg) {
+#else
+static void* __tffn_pool_worker(void* arg) {
+#endif
+    __TFFNWorkerPool* pool = (__TFFNWorkerPool*) arg;
+
+    __tffn_mutex_lock(&pool->lock);
+    while(!pool->stopping) {
+        __tffn_pool_work(pool);
+        if(!pool->stopping) __tffn_cond_wait(&pool->work_ready, &pool->lock);
+    }
+    __tffn_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static __TFFNWorkerPool* __tffn_pool_new(size_t thread_count) {
+    __TFFNWorkerPool* pool = (__TFFNWorkerPool*) TFFN_CALLOC(1, sizeof(__TFFNWorkerPool));
+    TFFN_ASSERT(pool != NULL && "Couldn't allocate memory");
+    __tffn_mutex_init(&pool->lock);
+    __tffn_cond_init(&pool->work_ready);
+    __tffn_cond_init(&pool->work_done);
+
+    pool->threads = (__tffn_thread_t*) TFFN_MALLOC(sizeof(__tffn_thread_t) * thread_count);
+    TFFN_ASSERT(pool->threads != NULL && "Couldn't allocate memory");
+    for (size_t i = 0; i < thread_count; i++) {
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, __tffn_pool_worker, pool, 0, NULL);
+        bool started = pool->threads[i] != NULL;
+#else
+        bool started = pthread_create(&pool->threads[i], NULL, __tffn_pool_worker, pool) == 0;
+#endif
+        if(!started) break; // fewer workers, the rendering thread does the rest
+        pool->thread_count++;
+    }
+
+    return pool;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_pool_free(__TFFNWorkerPool* pool) {
+    if(pool == NULL) return;
+
+    __tffn_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    __tffn_cond_broadcast(&pool->work_ready);
+    __tffn_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->thread_count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+    for (size_t i = 0; i < pool->task_capacity; i++) tffn_sb_free(pool->tasks[i].sb);
+    TFFN_FREE(pool->tasks);
+    TFFN_FREE(pool->threads);
+    __tffn_cond_destroy(&pool->work_ready);
+    __tffn_cond_destroy(&pool->work_done);
+    __tffn_mutex_destroy(&pool->lock);
+    TFFN_FREE(pool);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true if the given step can run on a worker thread: its action must be marked as parallel
+// and it must not read or write anything inside the parser (epoch memos for example)
+static bool __tffn_step_is_parallel(const __TFFNStep* step) {
+    if(step->kind != __TFFN_STEP_DYNAMIC || !step->dynamic_step->parallel) return false;
+    const __TFFNAction* action = step->dynamic_step;
+    return action->kind == __TFFN_ACTION_PARAM
+        || (action->kind == __TFFN_ACTION_DYNAMIC && action->policy == TFFN_ACTION_VOLATILE);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Runs every parallel action of the given steps on the pool (the calling thread helps too) and
+// returns how many there were, their outputs are in pool->tasks in step order
+// Nothing runs if there are less than TFFN_MIN_PARALLEL_STEPS of them
+static size_t __tffn_pool_run_steps(__TFFNWorkerPool* pool, __TFFNStep* steps) {
+    size_t count = 0;
+    for (__TFFNStep* step = steps; step != NULL; step = step->next) {
+        if(__tffn_step_is_parallel(step)) count++;
+    }
+    if(count < TFFN_MIN_PARALLEL_STEPS) return 0;
+
+    if(count > pool->task_capacity) {
+        pool->tasks = (__TFFNParallelTask*) TFFN_REALLOC(pool->tasks, sizeof(__TFFNParallelTask) * count);
+        TFFN_ASSERT(pool->tasks != NULL && "Couldn't allocate memory");
+        for (size_t i = pool->task_capacity; i < count; i++) pool->tasks[i].sb = tffn_sb_new(64);
+        pool->task_capacity = count;
+    }
+
+    size_t i = 0;
+    for (__TFFNStep* step = steps; step != NULL; step = step->next) {
+        if(!__tffn_step_is_parallel(step)) continue;
+        pool->tasks[i].step = step;
+        tffn_sb_clear(pool->tasks[i].sb);
+        i++;
+    }
+
+    __tffn_mutex_lock(&pool->lock);
+    pool->task_count = count;
+    pool->next_task = 0;
+    pool->finished_tasks = 0;
+    __tffn_cond_broadcast(&pool->work_ready);
+
+    __tffn_pool_work(pool);
+    while(pool->finished_tasks < pool->task_count) __tffn_cond_wait(&pool->work_done, &pool->lock);
+    pool->task_count = 0;
+    pool->next_task = 0;
+    __tffn_mutex_unlock(&pool->lock);
+
+    return count;
+}
+
+#endif // TFFN_ENABLE_THREADS
+
+
+// ------------------------------------------------------------ //
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns a word with the high bit of every byte of x that equals the byte c set
+// The bits above the first match can be wrong because of borrows, but a nonzero result
+// always means that x contains c somewhere
+static uint64_t __tffn_swar_match(uint64_t x, uint8_t c) {
+    const uint64_t ONES = 0x0101010101010101ULL;
+    const uint64_t HIGHS = 0x8080808080808080ULL;
+    uint64_t v = x ^ (ONES * c);
+    return (v - ONES) & ~v & HIGHS;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the index of the first '[', ']' or '!' in str[from..length), or length if there isnt any
+// Scans 8 bytes at a time since most of a format is plain text that doesnt need to be looked at
+static size_t __tffn_find_special(const char* str, size_t from, size_t length) {
+    size_t i = from;
+
+    while(i + 8 <= length) {
+        uint64_t word;
+        memcpy(&word, str + i, 8);
+        uint64_t mask = __tffn_swar_match(word, '[') | __tffn_swar_match(word, ']') | __tffn_swar_match(word, '!');
+        if(mask != 0) break; // the exact byte is found down below so endianness doesnt matter
+        i += 8;
+    }
+
+    while(i < length) {
+        char c = str[i];
+        if(c == '[' || c == ']' || c == '!') return i;
+        i++;
+    }
+
+    return length;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the index of the first character in str[from..length) that the given mode has to
+// escape, or length if there isnt any. Scans 8 bytes at a time like __tffn_find_special
+static size_t __tffn_find_escaped(const char* str, size_t from, size_t length, TFFNEscape escape) {
+    const uint64_t ONES = 0x0101010101010101ULL;
+    const uint64_t HIGHS = 0x8080808080808080ULL;
+    size_t i = from;
+
+    while(i + 8 <= length) {
+        uint64_t word, mask = 0;
+        memcpy(&word, str + i, 8);
+        switch (escape) {
+            case TFFN_ESCAPE_HTML: {
+                mask = __tffn_swar_match(word, '&') | __tffn_swar_match(word, '<') | __tffn_swar_match(word, '>')
+                    | __tffn_swar_match(word, '"') | __tffn_swar_match(word, '\'');
+            } break;
+
+            case TFFN_ESCAPE_JSON: {
+                // (word - 0x20 * ONES) & ~word sets the high bit of bytes below 0x20 (plus borrows)
+                mask = __tffn_swar_match(word, '"') | __tffn_swar_match(word, '\\') | ((word - ONES * 0x20) & ~word & HIGHS);
+            } break;
+
+            case TFFN_ESCAPE_SHELL: {
+                mask = __tffn_swar_match(word, '\'');
+            } break;
+
+            default: return length;
+        }
+        if(mask != 0) break;
+        i += 8;
+    }
+
+    while(i < length) {
+        unsigned char c = (unsigned char) str[i];
+        switch (escape) {
+            case TFFN_ESCAPE_HTML: if(c == '&' || c == '<' || c == '>' || c == '"' || c == '\'') return i; break;
+            case TFFN_ESCAPE_JSON: if(c == '"' || c == '\\' || c < 0x20) return i; break;
+            case TFFN_ESCAPE_SHELL: if(c == '\'') return i; break;
+            default: return length;
+        }
+        i++;
+    }
+
+    return length;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Writes the escaped form of c into out (which must fit 6 characters) and returns its length,
+// characters that dont need to be escaped are written as they are
+static size_t __tffn_escape_char(char c, TFFNEscape escape, char* out) {
+    const char* replacement = NULL;
+    switch (escape) {
+        case TFFN_ESCAPE_HTML: {
+            if(c == '&') replacement = "&amp;";
+            else if(c == '<') replacement = "&lt;";
+            else if(c == '>') replacement = "&gt;";
+            else if(c == '"') replacement = "&quot;";
+            else if(c == '\'') replacement = "&#39;";
+        } break;
+
+        case TFFN_ESCAPE_JSON: {
+            if(c == '"') replacement = "\\\"";
+            else if(c == '\\') replacement = "\\\\";
+            else if(c == '\n') replacement = "\\n";
+            else if(c == '\r') replacement = "\\r";
+            else if(c == '\t') replacement = "\\t";
+            else if(c == '\b') replacement = "\\b";
+            else if(c == '\f') replacement = "\\f";
+            else if((unsigned char) c < 0x20) {
+                const char* digits = "0123456789abcdef";
+                memcpy(out, "\\u00", 4);
+                out[4] = digits[(unsigned char) c >> 4];
+                out[5] = digits[(unsigned char) c & 15];
+                return 6;
+            }
+        } break;
+
+        case TFFN_ESCAPE_SHELL: {
+            if(c == '\'') replacement = "'\\''";
+        } break;
+
+        default: break;
+    }
+
+    if(replacement == NULL) {
+        out[0] = c;
+        return 1;
+    }
+    size_t length = strlen(replacement);
+    memcpy(out, replacement, length);
+    return length;
+}
+
+
+// Appends the sized string into the end of sb escaped with the given mode (see TFFNEscape)
+// Runs that dont need escaping are found 8 bytes at a time and copied at once
+// TFFN_ESCAPE_DEFAULT and TFFN_ESCAPE_RAW append the string as it is
+void tffn_sb_append_escaped(TFFNStrBuilder* sb, const char* str, size_t length, TFFNEscape escape) {
+    if(escape == TFFN_ESCAPE_SHELL) tffn_sb_append_char(sb, '\'');
+
+    size_t i = 0;
+    while(i < length) {
+        size_t next = __tffn_find_escaped(str, i, length, escape);
+        tffn_sb_append_sized(sb, str + i, next - i);
+        if(next == length) break;
+
+        char* out = tffn_sb_reserve(sb, 6);
+        tffn_sb_commit(sb, __tffn_escape_char(str[next], escape, out));
+        i = next + 1;
+    }
+
+    if(escape == TFFN_ESCAPE_SHELL) tffn_sb_append_char(sb, '\'');
+}
+
+
+// Escapes everything that got appended into sb after its first start characters in place, so
+// the output of a function that writes into sb can be escaped without a second buffer
+// Nothing gets copied if there isnt anything to escape, otherwise the escaped text is written
+// backwards from the new end of sb
+void tffn_sb_escape_tail(TFFNStrBuilder* sb, size_t start, TFFNEscape escape) {
+    if(escape == TFFN_ESCAPE_DEFAULT || escape == TFFN_ESCAPE_RAW || start > sb->count) return;
+
+    size_t first = __tffn_find_escaped(sb->buffer, start, sb->count, escape);
+    if(first == sb->count && escape != TFFN_ESCAPE_SHELL) return;
+
+    // Shell words are quoted as a whole, so their text always moves
+    if(escape == TFFN_ESCAPE_SHELL) first = start;
+
+    char scratch[6];
+    size_t extra = (escape == TFFN_ESCAPE_SHELL) ? 2 : 0;
+    for (size_t i = first; i < sb->count; i++) extra += __tffn_escape_char(sb->buffer[i], escape, scratch) - 1;
+
+    size_t old_count = sb->count;
+    tffn_sb_reserve(sb, extra);
+    size_t write = old_count + extra;
+    if(escape == TFFN_ESCAPE_SHELL) sb->buffer[--write] = '\'';
+
+    for (size_t i = old_count; i > first; i--) {
+        size_t length = __tffn_escape_char(sb->buffer[i - 1], escape, scratch);
+        write -= length;
+        memcpy(sb->buffer + write, scratch, length);
+    }
+
+    if(escape == TFFN_ESCAPE_SHELL) sb->buffer[--write] = '\'';
+    sb->count = old_count + extra;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the escaping mode for the output of an action inside a format with the given mode
+static TFFNEscape __tffn_escape_for(const __TFFNAction* action, TFFNEscape format_escape) {
+    return (action != NULL && action->escape != TFFN_ESCAPE_DEFAULT) ? action->escape : format_escape;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Compiles the first format_len characters of format into *steps_out, returns false and fills
+// parser->err if the format is invalid. Every static action that got folded into the steps is collected into
+// parser->compile_deps so the caller can register the dependencies of the new template
+// The text of static and pure actions gets escaped right here with the given escaping mode of the
+// format (see tffn_parser_set_format_escape), while the literal text of the format never does
+static bool __tffn_parse_steps(TFFNParser* parser, const char* format, size_t format_len,
+        TFFNEscape escape, __TFFNStep** steps_out, size_t* slot_count_out) {
+    tffn_sb_clear(parser->sb_part);
+    parser->compile_deps.count = 0;
+
+    __TFFNStep* steps_head = NULL;
+    size_t slot_count = 0;
+    
+    bool in_brack = false;
+    size_t brack_start = 0; // index of the first character inside the current bracket
+
+    size_t i = 0;
+    while(i < format_len) {
+        char c = format[i];
+
+        switch (c) {
+            case '[': {
+                if(in_brack) {
+                    __tffn_parser_set_error(parser, TFFN_ERR_NESTED_BRACKET, i, 0, 0);
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+
+                in_brack = true;
+                brack_start = i + 1;
+                i++;
+            } break;
+
+            case ']': {
+                if(!in_brack) {
+                    __tffn_parser_set_error(parser, TFFN_ERR_UNOPENED_BRACKET, i, 0, 0);
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+
+                in_brack = false;
+
+                // The bracket content is looked up right inside the format, no copies needed
+                const char* brack_content = format + brack_start;
+                size_t brack_length = i - brack_start;
+                const char* args_text;
+                size_t args_length;
+                bool inherited;
+                __TFFNAction* action = __tffn_parser_resolve_bracket(
+                    parser, brack_content, brack_length, &args_text, &args_length, &inherited
+                );
+                if(action != NULL) action = __tffn_parser_adopt_action(parser, action, inherited);
+
+                size_t slot;
+                if(action == NULL && __tffn_parse_slot(brack_content, brack_length, &slot)) {
+                    if(parser->sb_part->count > 0) {
+                        const char* static_str = __tffn_strings_intern(
+                            parser->strings, parser->sb_part->buffer, parser->sb_part->count
+                        );
+                        __tffn_append_static_step(&steps_head, static_str, parser->sb_part->count);
+                        tffn_sb_clear(parser->sb_part);
+                    }
+
+                    __tffn_append_slot_step(&steps_head, slot, escape);
+                    if(slot >= slot_count) slot_count = slot + 1;
+                }
+                else if(action == NULL) {
+                    __tffn_parser_set_error(parser, TFFN_ERR_UNDEFINED_ACTION, brack_start - 1, brack_start, brack_length);
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+                else if(args_text != NULL && action->kind != __TFFN_ACTION_PARAM) {
+                    __tffn_parser_set_error(
+                        parser, TFFN_ERR_UNEXPECTED_ARGS, brack_start - 1, brack_start, action->key_length
+                    );
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+                else if(action->kind == __TFFN_ACTION_STATIC) {
+                    tffn_sb_append_escaped(parser->sb_part, action->static_act, action->static_act_length,
+                        __tffn_escape_for(action, escape));
+                    // Static actions of a frozen base never change, so only the own ones are tracked
+                    if(!inherited) __tffn_action_list_push(&parser->compile_deps, action);
+                }
+                else if(action->kind == __TFFN_ACTION_DYNAMIC && action->policy == TFFN_ACTION_PURE) {
+                    // Pure actions run only once, after that they behave exactly like static actions
+                    if(action->memo == NULL) {
+                        action->memo = tffn_sb_new(64);
+                        action->dynamic_act(action->memo);
+                    }
+                    tffn_sb_append_escaped(parser->sb_part, action->memo->buffer, action->memo->count,
+                        __tffn_escape_for(action, escape));
+                }
+                else {
+                    if(parser->sb_part->count > 0) {
+                        const char* static_str = __tffn_strings_intern(
+                            parser->strings, parser->sb_part->buffer, parser->sb_part->count
+                        );
+                        __tffn_append_static_step(&steps_head, static_str, parser->sb_part->count);
+                        tffn_sb_clear(parser->sb_part);
+                    }
+                    
+                    TFFNArg* args = NULL;
+                    size_t arg_count = 0;
+                    if(args_text != NULL) {
+                        args = __tffn_split_args(args_text, args_length, &arg_count);
+                    }
+                    __tffn_append_dynamic_step(&steps_head, action, args, arg_count, escape);
+                }
+
+                i++;
+            } break;
+
+            case '!': {
+                if(in_brack) {
+                    __tffn_parser_set_error(parser, TFFN_ERR_BANG_IN_BRACKET, i, 0, 0);
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+                
+                if(i == format_len - 1) {
+                    __tffn_parser_set_error(parser, TFFN_ERR_TRAILING_BANG, i, 0, 0);
+                    __tffn_steps_free(steps_head);
+                    return false;
+                }
+
+                tffn_sb_append_char(parser->sb_part, format[i+1]);
+                i += 2;
+            } break;
+
+            default: {
+                // Skip (or copy) everything up to the next special character at once
+                size_t next = __tffn_find_special(format, i, format_len);
+                if(!in_brack) {
+                    tffn_sb_append_sized(parser->sb_part, format + i, next - i);
+                }
+
+                i = next;
+            } break;
+        }
+    }
+
+    // The format string ended but the last bracket was never closed
+    if(in_brack) {
+        __tffn_parser_set_error(parser, TFFN_ERR_UNCLOSED_BRACKET, brack_start - 1, 0, 0);
+        __tffn_steps_free(steps_head);
+        return false;
+    }
+
+    // Add the final static string part as a step
+    if(parser->sb_part->count > 0) {
+        const char* static_str = __tffn_strings_intern(parser->strings, parser->sb_part->buffer, parser->sb_part->count);
+        __tffn_append_static_step(&steps_head, static_str, parser->sb_part->count);
+        tffn_sb_clear(parser->sb_part);
+    }
+
+    *steps_out = steps_head;
+    *slot_count_out = slot_count;
+    return true;
+}
+
+
+// Returns the error of the last operation, err->code is TFFN_OK if it succeeded
+// Offsets point into the format that failed, the returned pointer stays valid until the parser is freed
+const TFFNError* tffn_parser_err(TFFNParser* parser) {
+    if (parser == NULL) return NULL;
+    return &parser->err;
+}
+
+
+// Returns the current error message of the parser as a newly allocated string
+// Errors are stored as plain codes and offsets, the message is only built when this gets called
+char* tffn_parser_err_msg(TFFNParser* parser) {
+    if (parser == NULL) return NULL;
+
+    const TFFNError* err = &parser->err;
+    const char* span = "";
+    size_t span_length = 0;
+    if(parser->err_text != NULL) {
+        span = parser->err_text + err->span_offset;
+        span_length = err->span_length;
+    }
+    TFFNStrBuilder* sb = tffn_sb_new(64 + span_length);
+
+    switch (err->code) {
+        case TFFN_OK: break;
+
+        case TFFN_ERR_NESTED_BRACKET: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: nesting brackets are prohibited in TFFN");
+        } break;
+
+        case TFFN_ERR_UNOPENED_BRACKET: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: you forgot to open a bracket");
+        } break;
+
+        case TFFN_ERR_UNCLOSED_BRACKET: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: you forgot to close a bracket");
+        } break;
+
+        case TFFN_ERR_BANG_IN_BRACKET: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: '!' token cant be used inside brackets");
+        } break;
+
+        case TFFN_ERR_TRAILING_BANG: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: format string cant end with '!'");
+        } break;
+
+        case TFFN_ERR_UNDEFINED_ACTION: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' action was never defined to the parser");
+        } break;
+
+        case TFFN_ERR_UNEXPECTED_ARGS: {
+            tffn_sb_append_nterm(sb, "INVALID FORMAT: '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' action doesnt take any arguments");
+        } break;
+
+        case TFFN_ERR_MISSING_VALUES: {
+            tffn_sb_append_nterm(sb, "INVALID VALUES: format needs more values than the ones given");
+        } break;
+
+        case TFFN_ERR_DUPLICATE_ACTION: {
+            tffn_sb_append_nterm(sb, "An action with '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' name already exists!");
+        } break;
+
+        case TFFN_ERR_NOT_STATIC_ACTION: {
+            tffn_sb_append_nterm(sb, "Action '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' is not a static action!");
+        } break;
+
+        case TFFN_ERR_FROZEN_PARSER: {
+            tffn_sb_append_nterm(sb, "Action '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' cant be defined since the parser is frozen!");
+        } break;
+
+        case TFFN_ERR_ACTION_PENDING: {
+            tffn_sb_append_nterm(sb, "Action '");
+            tffn_sb_append_sized(sb, span, span_length);
+            tffn_sb_append_nterm(sb, "' has to be waited for, use tffn_parser_render_async for it!");
+        } break;
+    }
+
+    char* msg = tffn_sb_to_str(sb);
+    tffn_sb_free(sb);
+    return msg;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static bool __tffn_validate_fail(TFFNError* err, TFFNErrorCode code, size_t offset,
+        size_t span_offset, size_t span_length) {
+    if(err != NULL) {
+        err->code = code;
+        err->offset = offset;
+        err->span_offset = span_offset;
+        err->span_length = span_length;
+    }
+    return false;
+}
+
+
+// Checks whether the first format_length characters of format would parse without any errors
+// This applies the exact same rules as tffn_parser_parse (bracket balance, '!' escapes and action
+// existence) but nothing gets compiled, cached or allocated and no dynamic actions are run
+// The parser itself is not modified either, if err is not NULL it receives the outcome and its
+// offsets point into format, tffn_parser_err_msg still refers to the last parse
+// TFFN_ERR_MISSING_VALUES is never reported since no values are given
+bool tffn_parser_validate(TFFNParser* parser, const char* format, size_t format_length, TFFNError* err) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_length == 0);
+
+    bool in_brack = false;
+    size_t brack_start = 0; // index of the first character inside the current bracket
+
+    size_t i = __tffn_find_special(format, 0, format_length);
+    while(i < format_length) {
+        switch (format[i]) {
+            case '[': {
+                if(in_brack) return __tffn_validate_fail(err, TFFN_ERR_NESTED_BRACKET, i, 0, 0);
+                in_brack = true;
+                brack_start = i + 1;
+                i++;
+            } break;
+
+            case ']': {
+                if(!in_brack) return __tffn_validate_fail(err, TFFN_ERR_UNOPENED_BRACKET, i, 0, 0);
+                in_brack = false;
+
+                const char* brack_content = format + brack_start;
+                size_t brack_length = i - brack_start;
+                const char* args_text;
+                size_t args_length;
+                bool inherited;
+                __TFFNAction* action = __tffn_parser_resolve_bracket(
+                    parser, brack_content, brack_length, &args_text, &args_length, &inherited
+                );
+
+                size_t slot;
+                if(action == NULL && !__tffn_parse_slot(brack_content, brack_length, &slot)) {
+                    return __tffn_validate_fail(
+                        err, TFFN_ERR_UNDEFINED_ACTION, brack_start - 1, brack_start, brack_length
+                    );
+                }
+                if(action != NULL && args_text != NULL && action->kind != __TFFN_ACTION_PARAM) {
+                    return __tffn_validate_fail(
+                        err, TFFN_ERR_UNEXPECTED_ARGS, brack_start - 1, brack_start, action->key_length
+                    );
+                }
+
+                i++;
+            } break;
+
+            default: { // '!'
+                if(in_brack) return __tffn_validate_fail(err, TFFN_ERR_BANG_IN_BRACKET, i, 0, 0);
+                if(i == format_length - 1) return __tffn_validate_fail(err, TFFN_ERR_TRAILING_BANG, i, 0, 0);
+                i += 2; // the escaped character is never special
+            } break;
+        }
+
+        i = __tffn_find_special(format, i, format_length);
+    }
+
+    if(in_brack) return __tffn_validate_fail(err, TFFN_ERR_UNCLOSED_BRACKET, brack_start - 1, 0, 0);
+
+    __tffn_validate_fail(err, TFFN_OK, 0, 0, 0);
+    return true;
+}
+
+
+// Frees the given parser
+// A parser that is the base of other parsers only goes away once all of them are freed, so
+// children can outlive the tffn_parser_free call of their base (the base cant be used after it)
+void tffn_parser_free(TFFNParser* parser) {
+    if(parser == NULL) return;
+
+    // Children of the same base can be freed from different threads, once only the parser itself
+    // is left its actions can change again (unless it was frozen by tffn_parser_freeze)
+    if(__tffn_atomic_sub(&parser->ref_count, 1) > 0) return;
+
+    // Free parser->format_cache
+    if (parser->format_cache != NULL) {
+        for (size_t i = 0; i < parser->format_cache->table_size; i++) {
+            __TFFNEntry* temp = parser->format_cache->entries[i];
+            while (temp != NULL) {
+                __TFFNEntry* next = temp->next;
+                __TFFNTemplate* tmpl = (__TFFNTemplate*) temp->object;
+                __tffn_steps_free(tmpl->steps);
+                __tffn_template_free_retired(tmpl);
+                TFFN_FREE(tmpl->cold);
+                TFFN_FREE(tmpl);
+                TFFN_FREE(temp->key);
+                TFFN_FREE(temp);
+                temp = next;
+            }
+        }
+
+        TFFN_FREE(parser->format_cache->entries);
+        TFFN_FREE(parser->format_cache);
+    }
+    
+    // Free parser->actions and parser->adopted, arena entries are freed all at once down below
+    __tffn_actions_free(parser->actions);
+    __tffn_actions_free(parser->adopted);
+
+    // Free parser->arenas
+    while (parser->arenas != NULL) {
+        __TFFNArena* next = parser->arenas->next;
+        TFFN_FREE(parser->arenas);
+        parser->arenas = next;
+    }
+
+#ifdef TFFN_ENABLE_THREADS
+    __tffn_pool_free(parser->pool);
+#endif
+    TFFN_FREE(parser->perfect_hash);
+    for (size_t i = 0; i < TFFN_MAX_NUMA_NODES; i++) TFFN_FREE(parser->replicas[i]);
+    TFFN_FREE(parser->compile_deps.items);
+    __tffn_strings_free(parser->strings); // after the format cache, its steps give their strings back
+    tffn_sb_free(parser->sb_part);
+    tffn_sb_free(parser->sb_res);
+    tffn_sb_free(parser->sb_err);
+
+    TFFNParser* base = parser->base;
+    TFFN_FREE(parser);
+    tffn_parser_free(base); // gives back the reference that tffn_parser_new_child took
+}
+
+
+// Internal variable, not meant to be used by this library's users
+// Last id given to a parser, a new parser can get the address of a freed one but never its id
+static uint64_t __tffn_last_parser_id = 0;
+
+
+// Internal helper function, not meant to be used by this library's users
+// Derives a key that no other key of the parser shares, children call this on their base from any thread
+static void __tffn_parser_derive_key(TFFNParser* parser, uint64_t key[2]) {
+    __tffn_derive_key(parser->seed, __tffn_atomic_add(&parser->key_count, 1), key);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static TFFNParser* __tffn_parser_new_seeded(const uint64_t seed[2]) {
+    TFFNParser* parser = (TFFNParser*) TFFN_MALLOC(sizeof(TFFNParser));
+    TFFN_ASSERT(parser != NULL && "Couldn't allocate memory");
+    parser->seed[0] = seed[0];
+    parser->seed[1] = seed[1];
+    parser->key_count = 0;
+    
+    // Init actions
+    parser->actions = __tffn_actions_new(128);
+    parser->adopted = NULL;
+
+    // Init format cache
+    {
+        const uint32_t TABLE_SIZE = 128;
+        parser->format_cache = (__TFFNHashTable*) TFFN_MALLOC(sizeof(__TFFNHashTable));
+        TFFN_ASSERT(parser->format_cache != NULL && "Couldn't allocate memory");
+
+        parser->format_cache->table_size = TABLE_SIZE;
+        parser->format_cache->entry_count = 0;
+        parser->format_cache->entries = (__TFFNEntry**) TFFN_CALLOC(sizeof(__TFFNEntry*), TABLE_SIZE);
+        TFFN_ASSERT(parser->format_cache->entries != NULL && "Couldn't allocate memory");
+        parser->format_cache->mode = TFFN_HASH_KEYED;
+        __tffn_parser_derive_key(parser, parser->format_cache->key);
+    }
+
+    parser->sb_part = tffn_sb_new(64);
+    parser->sb_err = tffn_sb_new(64);
+    parser->sb_res = tffn_sb_new(64);
+    parser->arenas = NULL;
+    parser->compile_deps.items = NULL;
+    parser->compile_deps.count = 0;
+    parser->compile_deps.capacity = 0;
+    parser->epoch = 0;
+    parser->action_generation = 0;
+    parser->failure_count = 0;
+    memset(parser->l0, 0, sizeof(parser->l0));
+    parser->immutable_formats = false;
+    parser->base = NULL;
+    parser->ref_count = 1;
+    parser->id = __tffn_atomic_add(&__tffn_last_parser_id, 1);
+    parser->frozen_for_good = false;
+    parser->perfect_hash = NULL;
+    parser->numa_node_count = 0;
+    parser->numa_node = 0;
+    memset(parser->replicas, 0, sizeof(parser->replicas));
+    parser->pool = NULL;
+    uint64_t strings_key[2];
+    __tffn_parser_derive_key(parser, strings_key);
+    parser->strings = __tffn_strings_new(strings_key);
+    parser->clock = 0;
+    __tffn_parser_clear_error(parser);
+    return parser;
+}
+
+
+// Returns a new TFFNParser instance
+// Freeing this instance is up to the user and can be done via tffn_parser_free function
+TFFNParser* tffn_parser_new() {
+    uint64_t seed[2];
+    __tffn_random_seed(seed);
+    return __tffn_parser_new_seeded(seed);
+}
+
+
+// Returns a new TFFNParser instance that sees every action of base without copying any of them
+// The child has its own actions (defined on top of the ones of base) and its own format cache,
+// lookups first check the child and then fall through to base, so creating a child is cheap no
+// matter how many actions base has. Updating an inherited static action only changes it for the child
+// base gets frozen: defining or updating its actions fails with TFFN_ERR_FROZEN_PARSER until
+// every child is freed, it can still be used to parse formats and to create more children
+// (children can be bases too). base is kept alive until every child is freed
+// Children of the same base can be created and freed from several threads at the same time
+TFFNParser* tffn_parser_new_child(TFFNParser* base) {
+    if (base == NULL) return NULL;
+
+    size_t node = 0;
+    if (base->numa_node_count > 1) node = TFFN_CURRENT_NUMA_NODE() % base->numa_node_count;
+    return tffn_parser_new_child_on_node(base, node);
+}
+
+
+// Same as tffn_parser_new_child but the child is placed on the given NUMA node instead of the node
+// of the calling thread, this only matters if NUMA replication is on (see tffn_parser_enable_numa)
+TFFNParser* tffn_parser_new_child_on_node(TFFNParser* base, size_t node) {
+    if (base == NULL) return NULL;
+
+    // Children get their seed from the base instead of the OS which keeps creating them cheap,
+    // derived seeds tell nothing about the seed of the base or about each other
+    uint64_t seed[2];
+    __tffn_parser_derive_key(base, seed);
+    TFFNParser* child = __tffn_parser_new_seeded(seed);
+    child->base = base;
+    __tffn_atomic_add(&base->ref_count, 1); // this alone freezes base, see __tffn_parser_frozen
+
+    child->numa_node_count = base->numa_node_count;
+    if (child->numa_node_count > 1) {
+        child->numa_node = node % child->numa_node_count;
+
+        // The first child of a node makes the replicas that it (and every later child of that node) reads,
+        // children of the same node can be created at the same time so only one of their copies is kept
+        for (TFFNParser* layer = base; layer != NULL; layer = layer->base) {
+            __TFFNPerfectHash** replica = &layer->replicas[child->numa_node];
+            if (layer->numa_node_count > 1 && layer->perfect_hash != NULL && __tffn_atomic_load(replica) == NULL) {
+                __TFFNPerfectHash* copy = __tffn_perfect_replicate(layer->perfect_hash);
+                if (!__tffn_atomic_publish(replica, copy)) TFFN_FREE(copy);
+            }
+        }
+    }
+
+    return child;
+}
+
+
+// Freezes the actions of the given parser for good, meant to be called once every action is
+// defined (after startup for example). Defining or updating actions fails with
+// TFFN_ERR_FROZEN_PARSER from now on and in return action names are looked up through a minimal
+// perfect hash with all names packed next to each other, so compiling a format only costs one
+// hash, one probe and one memcmp per bracket. Actions of a base (see tffn_parser_new_child)
+// are not part of it, bases can be frozen on their own
+void tffn_parser_freeze(TFFNParser* parser) {
+    if (parser == NULL || parser->frozen_for_good) return;
+
+    parser->frozen_for_good = true;
+    parser->perfect_hash = __tffn_perfect_build(parser->actions);
+}
+
+
+// Turns on NUMA replication for the children of the given parser (see tffn_parser_new_child)
+// A child only reads the actions of its base while compiling formats, so once the base is frozen
+// by tffn_parser_freeze every NUMA node gets its own copy of the frozen actions and children
+// read the copy of their own node. Copies are made lazily, by the first child of each node
+// (call tffn_parser_new_child from the thread that will use the child so its node is known and
+// the copy is allocated on that node). Compiled formats are always local since every child has its own
+// Only the frozen actions are replicated: children look brackets up in them while compiling and
+// the dynamic steps of their compiled formats point into them. The format cache, the compiled
+// formats and the pooled static text of the parser itself are never replicated, so formats that
+// get rendered on a shared parser from several nodes are read remotely, give every node a child instead
+// node_count is the amount of nodes, 0 detects it from /sys (this falls back to a single node
+// which turns replication off), anything else simulates that many nodes which is useful for
+// testing on single node machines. Nodes after TFFN_MAX_NUMA_NODES are not used
+// The node of the calling thread comes from TFFN_CURRENT_NUMA_NODE which can be redefined
+// before including the header file (to use libnuma for example)
+void tffn_parser_enable_numa(TFFNParser* parser, size_t node_count) {
+    if (parser == NULL) return;
+
+    if (node_count == 0) node_count = TFFN_NUMA_NODE_COUNT();
+    if (node_count > TFFN_MAX_NUMA_NODES) node_count = TFFN_MAX_NUMA_NODES;
+    parser->numa_node_count = node_count;
+}
+
+
+// Marks (or unmarks) an action of the parser as parallel: its function is thread safe and its
+// output doesnt depend on when it runs compared to the other actions of a format
+// Renders of a parser with workers (see tffn_parser_set_worker_count) run the parallel actions of
+// a format at the same time, each into its own buffer, and put their outputs in order afterwards
+// Only volatile dynamic actions and parameterized actions can run in parallel, the flag is ignored for others
+// Actions of a base cant be marked through a child and frozen parsers cant be changed
+void tffn_parser_set_parallel_action(TFFNParser* parser, const char* act_text, bool parallel) {
+    if (parser == NULL || act_text == NULL) return;
+
+    size_t act_text_length = strlen(act_text);
+    if (__tffn_parser_frozen(parser)) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_FROZEN_PARSER, act_text, act_text_length);
+        return;
+    }
+
+    bool inherited;
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    __TFFNAction* action = __tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited);
+    if (action == NULL || inherited) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_UNDEFINED_ACTION, act_text, act_text_length);
+        return;
+    }
+
+    __tffn_parser_clear_error(parser);
+    action->parallel = parallel;
+}
+
+
+// Gives the parser worker_count threads that run the parallel actions of a format at the same
+// time (see tffn_parser_set_parallel_action), the rendering thread helps them too. 0 stops the workers
+// Formats with less than TFFN_MIN_PARALLEL_STEPS parallel actions are rendered like before
+// Workers only exist if TFFN_ENABLE_THREADS is defined before including the header file together
+// with TFFN_IMPLEMENTATION (they use pthreads or the Win32 API), otherwise this does nothing
+void tffn_parser_set_worker_count(TFFNParser* parser, size_t worker_count) {
+    if (parser == NULL) return;
+
+#ifdef TFFN_ENABLE_THREADS
+    __tffn_pool_free(parser->pool);
+    parser->pool = (worker_count == 0) ? NULL : __tffn_pool_new(worker_count);
+#else
+    (void) worker_count;
+#endif
+}
+
+
+
+// Returns true if no parsing error occurred during the last tffn_parser_parse function call
+bool tffn_parser_okay(TFFNParser* parser) {
+    if (parser == NULL) return false; // parser is literally fucking NULL, do you think its okay?!?
+    return parser->err.code == TFFN_OK;
+}
+
+
+// Defines a static action to the given parser
+// act_text is the text that goes in between the brackets
+void tffn_parser_define_static_action(TFFNParser* parser, const char* act_text, const char* static_act) {
+    if (static_act == NULL || act_text == NULL) return;
+    tffn_parser_define_static_action_n(parser, act_text, strlen(act_text), static_act, strlen(static_act));
+}
+
+
+// Same as tffn_parser_define_static_action but both strings are sized and dont need to be
+// NULL terminated, static_act is not copied so it must stay alive as long as the parser does
+void tffn_parser_define_static_action_n(TFFNParser* parser, const char* act_text, size_t act_text_length,
+        const char* static_act, size_t static_act_length) {
+    if (parser == NULL || static_act == NULL || act_text == NULL) return;
+    if (act_text_length == 0) return;
+
+    __TFFNAction* action = __tffn_parser_new_action(parser, act_text, act_text_length);
+    if (action == NULL) return; // already exists or the parser is frozen
+
+    __tffn_parser_clear_error(parser);
+    action->kind = __TFFN_ACTION_STATIC;
+    action->static_act = static_act;
+    action->static_act_length = static_act_length;
+}
+
+
+// Defines a dynamic action to the given parser
+// act_text is the text that goes in between the brackets
+void tffn_parser_define_dynamic_action(TFFNParser* parser, const char* act_text, void(*dynamic_act)(TFFNStrBuilder*)) {
+    tffn_parser_define_dynamic_action_ex(parser, act_text, dynamic_act, TFFN_ACTION_VOLATILE);
+}
+
+
+// Defines a dynamic action with the given caching policy to the given parser
+//     - TFFN_ACTION_VOLATILE actions run on every parse, just like tffn_parser_define_dynamic_action
+//     - TFFN_ACTION_PURE actions run only once, the first time a format using them gets compiled,
+//           and their output is folded into the static text of every format that uses them
+//     - TFFN_ACTION_EPOCH actions run once per epoch, their output is memoized and copied into
+//           the result until tffn_parser_bump_epoch gets called
+void tffn_parser_define_dynamic_action_ex(TFFNParser* parser, const char* act_text,
+        void(*dynamic_act)(TFFNStrBuilder*), TFFNActionPolicy policy) {
+    if (act_text == NULL) return;
+    tffn_parser_define_dynamic_action_n(parser, act_text, strlen(act_text), dynamic_act, policy);
+}
+
+
+// Same as tffn_parser_define_dynamic_action_ex but act_text is sized and doesnt need to be NULL terminated
+void tffn_parser_define_dynamic_action_n(TFFNParser* parser, const char* act_text, size_t act_text_length,
+        void(*dynamic_act)(TFFNStrBuilder*), TFFNActionPolicy policy) {
+    if (parser == NULL || dynamic_act == NULL || act_text == NULL) return;
+    if (act_text_length == 0) return;
+
+    __TFFNAction* action = __tffn_parser_new_action(parser, act_text, act_text_length);
+    if (action == NULL) return; // already exists or the parser is frozen
+    
+    __tffn_parser_clear_error(parser);
+    action->kind = __TFFN_ACTION_DYNAMIC;
+    action->dynamic_act = dynamic_act;
+    action->policy = policy;
+}
+
+
+// Defines a parameterized action to the given parser, these actions can be used with arguments
+// like "[name:arg1,arg2]" or without any arguments like "[name]"
+// Arguments are split only once while compiling the format, param_act receives them as an
+// immutable array that stays the same on every parse
+void tffn_parser_define_param_action(TFFNParser* parser, const char* act_text,
+        void(*param_act)(TFFNStrBuilder*, const TFFNArg*, size_t)) {
+    if (act_text == NULL) return;
+    tffn_parser_define_param_action_n(parser, act_text, strlen(act_text), param_act);
+}
+
+
+// Same as tffn_parser_define_param_action but act_text is sized and doesnt need to be NULL terminated
+void tffn_parser_define_param_action_n(TFFNParser* parser, const char* act_text, size_t act_text_length,
+        void(*param_act)(TFFNStrBuilder*, const TFFNArg*, size_t)) {
+    if (parser == NULL || param_act == NULL || act_text == NULL) return;
+    if (act_text_length == 0) return;
+
+    __TFFNAction* action = __tffn_parser_new_action(parser, act_text, act_text_length);
+    if (action == NULL) return; // already exists or the parser is frozen
+    
+    __tffn_parser_clear_error(parser);
+    action->kind = __TFFN_ACTION_PARAM;
+    action->param_act = param_act;
+}
+
+
+// Defines an asynchronous action to the given parser, these actions can ask the render to wait
+// for them when their output isnt ready yet (because it comes from an event loop for example)
+// async_act either appends its output into sb and returns TFFN_ASYNC_DONE, or it stores whatever
+// it needs to continue later into *token and returns TFFN_ASYNC_PENDING. A render that
+// got TFFN_ASYNC_PENDING stops right there and calls async_act again with the same token once
+// tffn_async_resume gets called, *token is NULL on the first call
+// token itself is NULL when the render cant wait (tffn_parser_parse and friends), the action
+// should then either produce its output right away or return TFFN_ASYNC_PENDING which makes
+// that render fail with TFFN_ERR_ACTION_PENDING
+void tffn_parser_define_async_action(TFFNParser* parser, const char* act_text,
+        TFFNAsyncStatus(*async_act)(TFFNStrBuilder*, void**)) {
+    if (act_text == NULL) return;
+    tffn_parser_define_async_action_n(parser, act_text, strlen(act_text), async_act);
+}
+
+
+// Same as tffn_parser_define_async_action but act_text is sized and doesnt need to be NULL terminated
+void tffn_parser_define_async_action_n(TFFNParser* parser, const char* act_text, size_t act_text_length,
+        TFFNAsyncStatus(*async_act)(TFFNStrBuilder*, void**)) {
+    if (parser == NULL || async_act == NULL || act_text == NULL) return;
+    if (act_text_length == 0) return;
+
+    __TFFNAction* action = __tffn_parser_new_action(parser, act_text, act_text_length);
+    if (action == NULL) return; // already exists or the parser is frozen
+
+    __tffn_parser_clear_error(parser);
+    action->kind = __TFFN_ACTION_ASYNC;
+    action->async_act = async_act;
+}
+
+
+// Starts a new epoch, every TFFN_ACTION_EPOCH action will run again the next time it is needed
+void tffn_parser_bump_epoch(TFFNParser* parser) {
+    if (parser == NULL) return;
+    parser->epoch++;
+}
+
+
+// Chooses how the format cache hashes formats, the default is TFFN_HASH_KEYED which uses
+// SipHash-1-3 with a random key so formats coming from users cant be made to collide
+// TFFN_HASH_FAST skips the key and is a bit faster for formats that only come from trusted code,
+// if its chains ever get too long the cache switches back to TFFN_HASH_KEYED on its own
+void tffn_parser_set_hash_mode(TFFNParser* parser, TFFNHashMode mode) {
+    if (parser == NULL) return;
+    __tffn_htable_rekey(parser->format_cache, mode);
+}
+
+
+// Promises that the characters behind a format pointer never change once it was given to the
+// parser (string literals are a good example), false by default
+// Parsing a recently used format pointer is always cheap since the parser remembers which
+// template belongs to which pointer, but the contents still need to be compared to make sure
+// the memory wasnt reused for another format. Immutable formats skip that comparison (and the
+// strlen of tffn_parser_parse) so they are found by their address alone
+void tffn_parser_set_immutable_formats(TFFNParser* parser, bool immutable_formats) {
+    if (parser == NULL) return;
+    parser->immutable_formats = immutable_formats;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Marks every compiled template inside the format cache as stale
+static void __tffn_parser_mark_templates_stale(TFFNParser* parser) {
+    for (uint32_t i = 0; i < parser->format_cache->table_size; i++) {
+        for (__TFFNEntry* temp = parser->format_cache->entries[i]; temp != NULL; temp = temp->next) {
+            __TFFNTemplate* tmpl = (__TFFNTemplate*) temp->object;
+            if (tmpl->error.code == TFFN_OK) tmpl->stale = tmpl->rebind = true;
+        }
+    }
+}
+
+
+// Updates the value of a static action, or defines it if it doesnt exist yet
+// Only the compiled formats that used this action get invalidated, they will be recompiled
+// the next time they are parsed while the rest of the format cache stays untouched
+// Just like tffn_parser_define_static_action, static_act is not copied
+// Updating a static action that a child parser inherited from its base only changes it for that
+// child, the base keeps its own value (see tffn_parser_new_child)
+void tffn_parser_update_static_action(TFFNParser* parser, const char* act_text, const char* static_act) {
+    if (static_act == NULL || act_text == NULL) return;
+    tffn_parser_update_static_action_n(parser, act_text, strlen(act_text), static_act, strlen(static_act));
+}
+
+
+// Same as tffn_parser_update_static_action but both strings are sized and dont need to be NULL terminated
+void tffn_parser_update_static_action_n(TFFNParser* parser, const char* act_text, size_t act_text_length,
+        const char* static_act, size_t static_act_length) {
+    if (parser == NULL || static_act == NULL || act_text == NULL) return;
+    if (act_text_length == 0) return;
+
+    if (__tffn_parser_frozen(parser)) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_FROZEN_PARSER, act_text, act_text_length);
+        return;
+    }
+
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    bool inherited;
+    __TFFNAction* action = __tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited);
+
+    if (action != NULL && action->kind != __TFFN_ACTION_STATIC) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_NOT_STATIC_ACTION, act_text, act_text_length);
+        return;
+    }
+
+    if (action == NULL || inherited) {
+        // An action of the base gets shadowed, the templates that folded its text in were never
+        // registered as its dependents so every template of this parser has to be recompiled
+        if (inherited) __tffn_parser_mark_templates_stale(parser);
+
+        action = __tffn_parser_alloc_action(parser, act_text, act_text_length, hash);
+        action->kind = __TFFN_ACTION_STATIC;
+        parser->action_generation++;
+    }
+
+    __tffn_parser_clear_error(parser);
+    action->static_act = static_act;
+    action->static_act_length = static_act_length;
+
+    for (size_t i = 0; i < action->dependent_count; i++) {
+        action->dependents[i]->stale = true;
+    }
+}
+
+
+// Makes the output of an action escaped with the given mode wherever it is used, see TFFNEscape
+// This overrides the mode of the format (see tffn_parser_set_format_escape), TFFN_ESCAPE_RAW can
+// be used for actions that already output escaped text. The text of static and pure actions is
+// escaped once while compiling, dynamic outputs get escaped while they are being appended
+// Actions of a base cant be changed through a child and frozen parsers cant be changed
+void tffn_parser_set_action_escape(TFFNParser* parser, const char* act_text, TFFNEscape escape) {
+    if (parser == NULL || act_text == NULL) return;
+
+    size_t act_text_length = strlen(act_text);
+    if (__tffn_parser_frozen(parser)) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_FROZEN_PARSER, act_text, act_text_length);
+        return;
+    }
+
+    bool inherited;
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    __TFFNAction* action = __tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited);
+    if (action == NULL || inherited) {
+        __tffn_parser_set_name_error(parser, TFFN_ERR_UNDEFINED_ACTION, act_text, act_text_length);
+        return;
+    }
+
+    __tffn_parser_clear_error(parser);
+    if (action->escape == escape) return;
+    action->escape = escape;
+
+    // Text that got folded into compiled formats has to be escaped again
+    if (action->kind == __TFFN_ACTION_STATIC) {
+        for (size_t i = 0; i < action->dependent_count; i++) action->dependents[i]->stale = true;
+    }
+    else if (action->kind == __TFFN_ACTION_DYNAMIC && action->policy == TFFN_ACTION_PURE) {
+        __tffn_parser_mark_templates_stale(parser);
+    }
+}
+
+
+// Internal helper struct, not meant to be used by this library's users
+// Keeps track of the arena that a single bulk definition fills up
+typedef struct _TFFNBulkDefine {
+    __TFFNAction* entries; // next free entry inside the arena
+    char* keys;            // next free key byte inside the arena
+} __TFFNBulkDefine;
+
+
+// Internal helper function, not meant to be used by this library's users
+// Resizes the action table once and allocates a single arena that can hold action_count
+// entries followed by all of their keys, the arena is linked into the parser so it gets freed later
+static __TFFNBulkDefine __tffn_parser_bulk_begin(TFFNParser* parser, size_t action_count, size_t key_bytes) {
+    __TFFNActionTable* table = parser->actions;
+    __tffn_actions_resize(table, __tffn_htable_size_for(table->table_size, table->entry_count + action_count));
+
+    // Entries are placed right after the header, round it up so they stay aligned
+    size_t header_size = (sizeof(__TFFNArena) + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+
+    size_t byte_size = header_size + sizeof(__TFFNAction) * action_count + key_bytes;
+    __TFFNArena* arena = (__TFFNArena*) TFFN_MALLOC(byte_size);
+    TFFN_ASSERT(arena != NULL && "Couldn't allocate memory");
+    arena->byte_size = byte_size;
+    arena->next = parser->arenas;
+    parser->arenas = arena;
+
+    __TFFNBulkDefine bulk;
+    bulk.entries = (__TFFNAction*) ((char*) arena + header_size);
+    bulk.keys = (char*) (bulk.entries + action_count);
+    return bulk;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Takes the next entry of the arena and links it into the action table, returns NULL without
+// using up any arena space if an action with the same name already exists
+static __TFFNAction* __tffn_parser_bulk_add(TFFNParser* parser, __TFFNBulkDefine* bulk,
+        const char* act_text, size_t act_text_length) {
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    bool inherited;
+    if (__tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited) != NULL) return NULL;
+
+    __TFFNAction* entry = bulk->entries++;
+    memcpy(bulk->keys, act_text, act_text_length);
+    bulk->keys[act_text_length] = '\0';
+    entry->key = bulk->keys;
+    entry->key_length = act_text_length;
+    entry->hash = hash;
+    entry->static_act = NULL;
+    entry->static_act_length = 0;
+    entry->dynamic_act = NULL;
+    entry->param_act = NULL;
+    entry->async_act = NULL;
+    entry->policy = TFFN_ACTION_VOLATILE;
+    entry->parallel = false;
+    entry->escape = TFFN_ESCAPE_DEFAULT;
+    entry->memo = NULL;
+    entry->memo_epoch = 0;
+    entry->dependents = NULL;
+    entry->dependent_count = 0;
+    entry->dependent_capacity = 0;
+    entry->in_arena = true;
+    bulk->keys += act_text_length + 1;
+
+    __tffn_actions_link(parser->actions, entry);
+    parser->action_generation++;
+    return entry;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true and marks every result as TFFN_DEFINE_FROZEN if the parser is frozen
+static bool __tffn_parser_bulk_frozen(TFFNParser* parser, size_t action_count, TFFNDefineResult* results) {
+    if (!__tffn_parser_frozen(parser)) return false;
+
+    if (results != NULL) {
+        for (size_t i = 0; i < action_count; i++) results[i] = TFFN_DEFINE_FROZEN;
+    }
+    return true;
+}
+
+
+// Defines action_count static actions at once, this is much faster than calling
+// tffn_parser_define_static_action in a loop because:
+//     - the action table is resized only once to fit all of the new actions
+//     - every name is hashed only once
+//     - all entries and names are packed into a single allocation
+// Names dont need to be NULL terminated since their lengths are given, the static_act strings
+// are not copied so they must stay alive as long as the parser does (same as the single version)
+// If results is not NULL, results[i] will hold the outcome of defs[i]
+// Errors are only reported through results, the error of the parser is never set by this function
+// Returns how many actions were successfully defined
+size_t tffn_parser_define_static_actions(TFFNParser* parser, const TFFNStaticActionDef* defs,
+        size_t action_count, TFFNDefineResult* results) {
+    if (parser == NULL || defs == NULL || action_count == 0) return 0;
+    __tffn_parser_clear_error(parser);
+    if (__tffn_parser_bulk_frozen(parser, action_count, results)) return 0;
+
+    size_t key_bytes = 0;
+    for (size_t i = 0; i < action_count; i++) {
+        key_bytes += defs[i].act_text_length + 1;
+    }
+
+    __TFFNBulkDefine bulk = __tffn_parser_bulk_begin(parser, action_count, key_bytes);
+
+    size_t defined_count = 0;
+    for (size_t i = 0; i < action_count; i++) {
+        const TFFNStaticActionDef* def = &defs[i];
+        TFFNDefineResult res = TFFN_DEFINE_OK;
+
+        if (def->act_text == NULL || def->act_text_length == 0 || def->static_act == NULL) {
+            res = TFFN_DEFINE_INVALID;
+        }
+        else {
+            __TFFNAction* action = __tffn_parser_bulk_add(parser, &bulk, def->act_text, def->act_text_length);
+            if (action == NULL) {
+                res = TFFN_DEFINE_DUPLICATE;
+            }
+            else {
+                action->kind = __TFFN_ACTION_STATIC;
+                action->static_act = def->static_act;
+                action->static_act_length = strlen(def->static_act);
+                defined_count++;
+            }
+        }
+
+        if (results != NULL) results[i] = res;
+    }
+
+    return defined_count;
+}
+
+
+// Defines action_count dynamic actions at once, see tffn_parser_define_static_actions
+// for more information since this function works the exact same way
+size_t tffn_parser_define_dynamic_actions(TFFNParser* parser, const TFFNDynamicActionDef* defs,
+        size_t action_count, TFFNDefineResult* results) {
+    if (parser == NULL || defs == NULL || action_count == 0) return 0;
+    __tffn_parser_clear_error(parser);
+    if (__tffn_parser_bulk_frozen(parser, action_count, results)) return 0;
+
+    size_t key_bytes = 0;
+    for (size_t i = 0; i < action_count; i++) {
+        key_bytes += defs[i].act_text_length + 1;
+    }
+
+    __TFFNBulkDefine bulk = __tffn_parser_bulk_begin(parser, action_count, key_bytes);
+
+    size_t defined_count = 0;
+    for (size_t i = 0; i < action_count; i++) {
+        const TFFNDynamicActionDef* def = &defs[i];
+        TFFNDefineResult res = TFFN_DEFINE_OK;
+
+        if (def->act_text == NULL || def->act_text_length == 0 || def->dynamic_act == NULL) {
+            res = TFFN_DEFINE_INVALID;
+        }
+        else {
+            __TFFNAction* action = __tffn_parser_bulk_add(parser, &bulk, def->act_text, def->act_text_length);
+            if (action == NULL) {
+                res = TFFN_DEFINE_DUPLICATE;
+            }
+            else {
+                action->kind = __TFFN_ACTION_DYNAMIC;
+                action->dynamic_act = def->dynamic_act;
+                action->policy = def->policy;
+                defined_count++;
+            }
+        }
+
+        if (results != NULL) results[i] = res;
+    }
+
+    return defined_count;
+}
+
+
+// Returns the action with the given name or NULL if there isnt one, the name doesnt need to be
+// NULL terminated. The returned action stays valid as long as the parser does, this is meant
+// for code that resolves action names once and runs them many times (like tffn.hpp does)
+__TFFNAction* tffn_parser_find_action(TFFNParser* parser, const char* act_text, size_t act_text_length) {
+    if (parser == NULL || act_text == NULL) return NULL;
+
+    uint64_t hash = __tffn_hash_sized(act_text, act_text_length);
+    bool inherited;
+    __TFFNAction* action = __tffn_parser_lookup_action(parser, act_text, act_text_length, hash, &inherited);
+    if(action == NULL) return NULL;
+    return __tffn_parser_adopt_action(parser, action, inherited);
+}
+
+
+// Appends the output of the given action into sb exactly like parsing "[action]" would, caching
+// policies are respected and args are only given to parameterized actions
+// Returns false (and sets a TFFN_ERR_ACTION_PENDING error) if an asynchronous action couldnt
+// finish without waiting, see tffn_parser_define_async_action
+bool tffn_parser_run_action(TFFNParser* parser, __TFFNAction* action, const TFFNArg* args,
+        size_t arg_count, TFFNStrBuilder* sb) {
+    TFFN_ASSERT(parser != NULL && action != NULL && sb != NULL);
+
+    if(action->kind == __TFFN_ACTION_STATIC) {
+        tffn_sb_append_sized(sb, action->static_act, action->static_act_length);
+        return true;
+    }
+
+    if(action->kind == __TFFN_ACTION_PARAM) {
+        action->param_act(sb, args, arg_count);
+        return true;
+    }
+
+    if(action->kind == __TFFN_ACTION_ASYNC) {
+        if(action->async_act(sb, NULL) == TFFN_ASYNC_DONE) return true;
+        __tffn_parser_set_name_error(parser, TFFN_ERR_ACTION_PENDING, action->key, action->key_length);
+        return false;
+    }
+
+    if(action->policy == TFFN_ACTION_VOLATILE) {
+        action->dynamic_act(sb);
+        return true;
+    }
+
+    // Pure actions run only once, epoch actions run once per epoch
+    bool outdated = action->policy == TFFN_ACTION_EPOCH && action->memo_epoch != parser->epoch;
+    if(action->memo == NULL || outdated) {
+        if(action->memo == NULL) action->memo = tffn_sb_new(64);
+        tffn_sb_clear(action->memo);
+        action->dynamic_act(action->memo);
+        action->memo_epoch = parser->epoch;
+    }
+
+    tffn_sb_append_sized(sb, action->memo->buffer, action->memo->count);
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Adds a new template into the format cache, the template holds either the compiled steps of
+// format or (if parser->err is set) the reason why format failed to compile
+static __TFFNTemplate* __tffn_parser_cache_template(TFFNParser* parser, const char* format, size_t format_len,
+        __TFFNStep* steps, size_t slot_count) {
+    __TFFNTemplate* tmpl = (__TFFNTemplate*) TFFN_MALLOC(sizeof(__TFFNTemplate));
+    TFFN_ASSERT(tmpl != NULL && "Couldn't allocate memory");
+    tmpl->steps = steps;
+    tmpl->slot_count = slot_count;
+    tmpl->error = parser->err;
+    tmpl->action_generation = parser->action_generation;
+    tmpl->stale = false;
+    tmpl->rebind = false;
+    tmpl->pin_count = 0;
+    tmpl->hold_count = 0;
+    tmpl->version = 0;
+    tmpl->last_use = parser->clock;
+    tmpl->cold = NULL;
+    tmpl->retired = NULL;
+    tmpl->escape = TFFN_ESCAPE_DEFAULT;
+
+    __TFFNEntry* entry = __tffn_htable_insert(parser->format_cache, format, format_len, (void*) tmpl);
+    TFFN_ASSERT(entry != NULL);
+    tmpl->format = entry->key;
+    tmpl->format_length = format_len;
+    return tmpl;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Registers tmpl as a dependent of every static action that got folded into it
+static void __tffn_parser_register_deps(TFFNParser* parser, __TFFNTemplate* tmpl) {
+    for (size_t i = 0; i < parser->compile_deps.count; i++) {
+        __tffn_action_add_dependent(parser->compile_deps.items[i], tmpl);
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the L0 slot of the given format pointer
+static __TFFNL0Entry* __tffn_l0_slot(TFFNParser* parser, const char* format) {
+    uint64_t mixed = (uint64_t) (uintptr_t) format * 0x9E3779B97F4A7C15ULL;
+    return &parser->l0[(mixed >> 32) & (TFFN_L0_CACHE_SIZE - 1)];
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the template that the L0 cache remembers for this exact pointer and length or NULL
+// Unless formats are immutable, the contents are compared too since the memory behind a
+// pointer can be reused for a different format
+static __TFFNTemplate* __tffn_l0_find(TFFNParser* parser, const char* format, size_t format_len) {
+    __TFFNL0Entry* slot = __tffn_l0_slot(parser, format);
+    if(slot->format != format || slot->format_length != format_len) return NULL;
+    if(!parser->immutable_formats && memcmp(slot->tmpl->format, format, format_len) != 0) return NULL;
+    return slot->tmpl;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+static void __tffn_l0_store(TFFNParser* parser, const char* format, size_t format_len, __TFFNTemplate* tmpl) {
+    __TFFNL0Entry* slot = __tffn_l0_slot(parser, format);
+    slot->format = format;
+    slot->format_length = format_len;
+    slot->tmpl = tmpl;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Makes a cached template ready to be rendered: stale templates get recompiled and failures that
+// might compile now are retried, returns NULL and sets parser->err if the format is still invalid
+static __TFFNTemplate* __tffn_parser_refresh_template(TFFNParser* parser, __TFFNTemplate* tmpl) {
+    tmpl->last_use = ++parser->clock;
+    if(tmpl->cold != NULL) __tffn_template_thaw(parser, tmpl);
+
+    if(tmpl->error.code != TFFN_OK) {
+        // Only a missing action can stop being a problem later on, and only if a new action got
+        // defined since the last try, every other failure is reported right away
+        bool may_compile = (tmpl->error.code == TFFN_ERR_UNDEFINED_ACTION || tmpl->error.code == TFFN_ERR_UNEXPECTED_ARGS)
+            && tmpl->action_generation != parser->action_generation;
+
+        __TFFNStep* steps = NULL;
+        size_t slot_count = 0;
+        if(!may_compile || !__tffn_parse_steps(parser, tmpl->format, tmpl->format_length, tmpl->escape, &steps, &slot_count)) {
+            if(may_compile) {
+                tmpl->error = parser->err;
+                tmpl->action_generation = parser->action_generation;
+            }
+
+            parser->err = tmpl->error;
+            parser->err_text = tmpl->format;
+            return NULL;
+        }
+
+        tmpl->steps = steps;
+        tmpl->slot_count = slot_count;
+        tmpl->error.code = TFFN_OK;
+        parser->failure_count--;
+        __tffn_parser_register_deps(parser, tmpl);
+    }
+    else if(tmpl->stale) {
+        // Actions can only be added or updated, never removed, so a format that compiled
+        // once always compiles again and depends on the exact same actions (unless an
+        // inherited action got shadowed, the shadowing action is a new dependency then)
+        __TFFNStep* steps = NULL;
+        size_t slot_count = 0;
+        bool okay = __tffn_parse_steps(parser, tmpl->format, tmpl->format_length, tmpl->escape, &steps, &slot_count);
+        TFFN_ASSERT(okay && "A stale format failed to recompile");
+        (void) okay;
+
+        __tffn_template_retire_steps(tmpl);
+        tmpl->steps = steps;
+        tmpl->version++;
+        tmpl->stale = false;
+        if(tmpl->rebind) __tffn_parser_register_deps(parser, tmpl);
+        tmpl->rebind = false;
+    }
+
+    return tmpl;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the compiled template of the given format, compiling it (or recompiling it if it went
+// stale) when needed, returns NULL and sets parser->err if the format is invalid
+// Invalid formats are cached too (up to TFFN_MAX_CACHED_FAILURES of them) so parsing the same
+// invalid format again only costs a single lookup and doesnt allocate anything
+// The L0 cache is checked first so reusing the same format pointer doesnt even need to hash it
+static __TFFNTemplate* __tffn_parser_get_template(TFFNParser* parser, const char* format, size_t format_len) {
+    __TFFNTemplate* tmpl = __tffn_l0_find(parser, format, format_len);
+    if(tmpl != NULL) return __tffn_parser_refresh_template(parser, tmpl);
+
+    tmpl = (__TFFNTemplate*) __tffn_htable_lookup(parser->format_cache, format, format_len);
+    if(tmpl != NULL) {
+        __tffn_l0_store(parser, format, format_len, tmpl);
+        return __tffn_parser_refresh_template(parser, tmpl);
+    }
+
+    __TFFNStep* steps = NULL;
+    size_t slot_count = 0;
+    if(!__tffn_parse_steps(parser, format, format_len, TFFN_ESCAPE_DEFAULT, &steps, &slot_count)) { // parsing error happened
+        if(parser->failure_count >= TFFN_MAX_CACHED_FAILURES) {
+            // Not remembered, keep a copy of the format so the error message can still be built
+            tffn_sb_clear(parser->sb_err);
+            tffn_sb_append_sized(parser->sb_err, format, format_len);
+            parser->err_text = parser->sb_err->buffer;
+            return NULL;
+        }
+
+        tmpl = __tffn_parser_cache_template(parser, format, format_len, NULL, 0);
+        __tffn_l0_store(parser, format, format_len, tmpl);
+        parser->failure_count++;
+        parser->err_text = tmpl->format;
+        return NULL;
+    }
+
+    __tffn_parser_clear_error(parser); // the template would remember an older error otherwise
+    tmpl = __tffn_parser_cache_template(parser, format, format_len, steps, slot_count);
+    __tffn_l0_store(parser, format, format_len, tmpl);
+    __tffn_parser_register_deps(parser, tmpl);
+    return tmpl;
+}
+
+
+// Sets the escaping mode of a format, the text that its actions and "[$N]" slots put into the
+// result gets escaped with it (unless an action has its own mode, see tffn_parser_set_action_escape)
+// while the literal text of the format stays as it is, see TFFNEscape
+// The format gets compiled if it wasnt already, nothing changes and the error of the parser is
+// set if it is invalid. Its static parts get escaped again the next time it is rendered
+void tffn_parser_set_format_escape(TFFNParser* parser, const char* format, size_t format_len, TFFNEscape escape) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_len == 0);
+    if(format_len == 0) return;
+
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, format, format_len);
+    if(tmpl == NULL || tmpl->escape == escape) return;
+    tmpl->escape = escape;
+    tmpl->stale = true;
+}
+
+
+// Formats the given value right into the end of sb, exactly like a "[$N]" slot would
+void tffn_sb_append_value(TFFNStrBuilder* sb, const TFFNValue* value) {
+    switch (value->type) {
+        case TFFN_VALUE_STR: {
+            tffn_sb_append_sized(sb, value->as.str.ptr, value->as.str.length);
+        } break;
+
+        case TFFN_VALUE_I64: {
+            tffn_sb_append_i64(sb, value->as.i64);
+        } break;
+
+        case TFFN_VALUE_F64: {
+            tffn_sb_append_f64(sb, value->as.f64);
+        } break;
+    }
+}
+
+
+// Returns a TFFNValue that holds a sized string, the string is not copied
+TFFNValue tffn_value_str(const char* str, size_t length) {
+    TFFNValue value;
+    value.type = TFFN_VALUE_STR;
+    value.as.str.ptr = str;
+    value.as.str.length = length;
+    return value;
+}
+
+
+// Returns a TFFNValue that holds a 64 bit signed integer
+TFFNValue tffn_value_i64(int64_t num) {
+    TFFNValue value;
+    value.type = TFFN_VALUE_I64;
+    value.as.i64 = num;
+    return value;
+}
+
+
+// Returns a TFFNValue that holds a double
+TFFNValue tffn_value_f64(double num) {
+    TFFNValue value;
+    value.type = TFFN_VALUE_F64;
+    value.as.f64 = num;
+    return value;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns true if rendering tmpl always gives the same text, which is its only step (if any)
+static bool __tffn_template_is_static(const __TFFNTemplate* tmpl) {
+    return tmpl->steps == NULL || (tmpl->steps->kind == __TFFN_STEP_STATIC && tmpl->steps->next == NULL);
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Appends the output of a single step into sb, escaped like its format wants it
+// Returns false if its action couldnt run, the error of the parser is set then
+static bool __tffn_parser_run_step(TFFNParser* parser, __TFFNStep* step, const TFFNValue* values, TFFNStrBuilder* sb) {
+    switch (step->kind) {
+        case __TFFN_STEP_STATIC: {
+            tffn_sb_append_sized(sb, step->static_step, step->static_length);
+        } break;
+
+        case __TFFN_STEP_DYNAMIC: {
+            size_t start = sb->count;
+            if(!tffn_parser_run_action(parser, step->dynamic_step, step->args, step->arg_count, sb)) return false;
+            tffn_sb_escape_tail(sb, start, __tffn_escape_for(step->dynamic_step, step->escape));
+        } break;
+
+        case __TFFN_STEP_SLOT: {
+            size_t start = sb->count;
+            tffn_sb_append_value(sb, &values[step->slot]);
+            tffn_sb_escape_tail(sb, start, step->escape);
+        } break;
+    }
+
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Renders a template that __tffn_parser_get_template returned into parser->sb_res, tmpl is NULL
+// if that failed. Returns false if an error happened
+static bool __tffn_parser_run_template(TFFNParser* parser, __TFFNTemplate* tmpl,
+        const TFFNValue* values, size_t value_count) {
+    if(tmpl == NULL) return false; // parsing error happened
+
+    if(tmpl->slot_count > value_count) {
+        __tffn_parser_set_error(parser, TFFN_ERR_MISSING_VALUES, 0, 0, 0);
+        parser->err_text = tmpl->format;
+        return false;
+    }
+
+    __TFFNStep* step = tmpl->steps;
+    tffn_sb_clear(parser->sb_res);
+
+    // Parallel actions run first, every other step is handled in order below
+    size_t parallel_count = 0, parallel_index = 0;
+#ifdef TFFN_ENABLE_THREADS
+    if(parser->pool != NULL) parallel_count = __tffn_pool_run_steps(parser->pool, step);
+#endif
+
+    while(step != NULL) {
+#ifdef TFFN_ENABLE_THREADS
+        if(parallel_count > 0 && __tffn_step_is_parallel(step)) {
+            TFFNStrBuilder* out = parser->pool->tasks[parallel_index++].sb;
+            tffn_sb_append_escaped(parser->sb_res, out->buffer, out->count,
+                __tffn_escape_for(step->dynamic_step, step->escape));
+            step = step->next;
+            continue;
+        }
+#endif
+        if(!__tffn_parser_run_step(parser, step, values, parser->sb_res)) return false;
+        step = step->next;
+    }
+
+    (void) parallel_count; (void) parallel_index; // unused without TFFN_ENABLE_THREADS
+    __tffn_parser_clear_error(parser);
+    return true;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Renders a template into a newly allocated string, tmpl is NULL if compiling it failed
+static char* __tffn_parser_render_template(TFFNParser* parser, __TFFNTemplate* tmpl,
+        const TFFNValue* values, size_t value_count) {
+    // Static templates are copied straight out of their only step
+    if(tmpl != NULL && tmpl->slot_count == 0 && __tffn_template_is_static(tmpl)) {
+        size_t length = tmpl->steps == NULL ? 0 : tmpl->steps->static_length;
+        char* result_str = (char*) TFFN_MALLOC(length + 1);
+        TFFN_ASSERT(result_str != NULL && "Couldn't allocate memory");
+        if(length > 0) memcpy(result_str, tmpl->steps->static_step, length);
+        result_str[length] = '\0';
+        __tffn_parser_clear_error(parser);
+        return result_str;
+    }
+
+    if(!__tffn_parser_run_template(parser, tmpl, values, value_count)) return NULL;
+
+    char* result_str = tffn_sb_to_str(parser->sb_res);
+    tffn_sb_clear(parser->sb_res);
+    return result_str;
+}
+
+
+// Parses the given format just like tffn_parser_parse, but "[$0]", "[$1]"... slots in the format
+// get replaced by values[0], values[1]... while rendering
+// Slots are resolved while compiling so rendering them doesnt need any dynamic actions or lookups
+// value_count must be bigger than every slot index used by the format, otherwise an error happens
+// Returns a newly allocated string that needs to be freed by the user, or NULL if an error happened
+char* tffn_parser_render(TFFNParser* parser, const char* format, const TFFNValue* values, size_t value_count) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL);
+
+    // Immutable formats that were seen before dont even need their length to be computed
+    if(parser->immutable_formats) {
+        __TFFNL0Entry* slot = __tffn_l0_slot(parser, format);
+        if(slot->format == format) {
+            return __tffn_parser_render_template(parser, __tffn_parser_refresh_template(parser, slot->tmpl),
+                values, value_count);
+        }
+    }
+
+    return tffn_parser_render_n(parser, format, strlen(format), values, value_count);
+}
+
+
+// Same as tffn_parser_render but the format is sized and doesnt need to be NULL terminated
+char* tffn_parser_render_n(TFFNParser* parser, const char* format, size_t format_len,
+        const TFFNValue* values, size_t value_count) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_len == 0);
+
+    if(format_len == 0) {
+        __tffn_parser_clear_error(parser);
+        return (char*) ""; // format is empty string
+    }
+
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, format, format_len);
+    return __tffn_parser_render_template(parser, tmpl, values, value_count);
+}
 
-                char* brack_content = tffn_sb_to_str(parser->sb_brack);
-                tffn_sb_clear(parser->sb_brack);
 
-                void* static_action = __tffn_htable_lookup(parser->static_actions, brack_content);
-                
-                void(*dynamic_action)(TFFNStrBuilder*);
-                dynamic_action = __tffn_fhtable_lookup(parser->dynamic_actions, brack_content);
+// Parses the given format using the given parser and returns the result as a newly allocated string
+// Its up to the user to free this string when it needs to be freed
+// Using this function will never invalidate 'format' strings so you can keep using the same string
+// If an error occurs during the parsing the following things will happen:
+//     - The error will be stored inside the parser, see tffn_parser_okay, tffn_parser_err and
+//           tffn_parser_err_msg functions for more information
+//     - This function will return NULL instead of a newly allocated string
+char* tffn_parser_parse(TFFNParser* parser, const char* format) {
+    return tffn_parser_render(parser, format, NULL, 0);
+}
 
-                if(static_action != NULL) {
-                    char* step = (char*) static_action;
-                    tffn_sb_append_nterm(parser->sb_part, step);
-                }
-                else if(dynamic_action != NULL) {
-                    if(parser->sb_part->count > 0) {
-                        char* static_str = tffn_sb_to_str(parser->sb_part);
-                        __tffn_append_static_step(&steps_head, static_str);
-                        tffn_sb_clear(parser->sb_part);
-                    }
-                    
-                    __tffn_append_dynamic_step(&steps_head, dynamic_action);
-                }
-                else {
-                    tffn_sb_clear(parser->sb_err);
-                    char buffer[512];
-                    sprintf(buffer, "INVALID FORMAT: '%s' action was never defined to the parser", brack_content);
-                    tffn_sb_append_nterm(parser->sb_err, buffer);
-                    TFFN_FREE(brack_content);
-                    return NULL;
-                }
 
-                TFFN_FREE(brack_content);
-                i++;
-            } break;
+// Same as tffn_parser_parse but the format is sized and doesnt need to be NULL terminated
+char* tffn_parser_parse_n(TFFNParser* parser, const char* format, size_t format_len) {
+    return tffn_parser_render_n(parser, format, format_len, NULL, 0);
+}
 
-            case '!': {
-                if(in_brack) {
-                    tffn_sb_clear(parser->sb_err);
-                    tffn_sb_append_nterm(
-                        parser->sb_err, "INVALID FORMAT: '!' token cant be used inside brackets"
-                    );
-                    return NULL;
-                }
-                
-                if(i == format_len - 1) {
-                    tffn_sb_clear(parser->sb_err);
-                    tffn_sb_append_nterm(
-                        parser->sb_err, "INVALID FORMAT: format string cant end with '!'"
-                    );
-                    return NULL;
-                }
 
-                tffn_sb_append_char(parser->sb_part, format[i+1]);
-                i += 2;
+// Same as tffn_parser_render_n but nothing is allocated, the result is borrowed from the parser:
+//     - if the format only has static text (like "[h] [w]!!" with static actions), the view
+//           points right into the compiled format, it stays valid until the parser is freed or
+//           one of the static actions that the format uses gets updated
+//     - otherwise the view points into the result buffer of the parser, it stays valid until
+//           the next parse or render call on this parser
+// Copy the string if you need it for longer, view.str is NULL if an error happened
+TFFNStrView tffn_parser_render_view(TFFNParser* parser, const char* format, size_t format_len,
+        const TFFNValue* values, size_t value_count) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_len == 0);
+
+    TFFNStrView view;
+    view.str = "";
+    view.length = 0;
+
+    if(format_len == 0) {
+        __tffn_parser_clear_error(parser);
+        return view;
+    }
+
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, format, format_len);
+    if(tmpl != NULL && tmpl->slot_count == 0 && __tffn_template_is_static(tmpl)) {
+        if(tmpl->steps != NULL) {
+            view.str = tmpl->steps->static_step;
+            view.length = tmpl->steps->static_length;
+            (((__TFFNPooledString*) view.str) - 1)->pinned = true; // see __tffn_parser_compact_strings
+        }
+        __tffn_parser_clear_error(parser);
+        return view;
+    }
+
+    if(!__tffn_parser_run_template(parser, tmpl, values, value_count)) {
+        view.str = NULL;
+        return view;
+    }
+
+    // Terminate the result without counting the '\0' so the buffer can be reused as it is
+    tffn_sb_reserve(parser->sb_res, 1)[0] = '\0';
+    view.str = parser->sb_res->buffer;
+    view.length = parser->sb_res->count;
+    return view;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Runs the steps of an asynchronous render until it is done or an action has to be waited for
+static TFFNRenderStatus __tffn_async_run(TFFNAsyncRender* render) {
+    while(render->step != NULL) {
+        __TFFNStep* step = render->step;
+
+        switch (step->kind) {
+            case __TFFN_STEP_STATIC: {
+                tffn_sb_append_sized(render->sb, step->static_step, step->static_length);
             } break;
 
-            default: {
-                if(in_brack) {
-                    tffn_sb_append_char(parser->sb_brack, c);
+            case __TFFN_STEP_DYNAMIC: {
+                __TFFNAction* action = step->dynamic_step;
+                size_t start = render->sb->count;
+                if(action->kind != __TFFN_ACTION_ASYNC) {
+                    tffn_parser_run_action(render->parser, action, step->args, step->arg_count, render->sb);
+                }
+                else if(action->async_act(render->sb, &render->token) == TFFN_ASYNC_PENDING) {
+                    return TFFN_RENDER_PENDING; // the cursor stays on this step
                 }
                 else {
-                    tffn_sb_append_char(parser->sb_part, c);
+                    render->token = NULL;
                 }
+                tffn_sb_escape_tail(render->sb, start, __tffn_escape_for(action, step->escape));
+            } break;
 
-                i++;
+            case __TFFN_STEP_SLOT: {
+                size_t start = render->sb->count;
+                tffn_sb_append_value(render->sb, &render->values[step->slot]);
+                tffn_sb_escape_tail(render->sb, start, step->escape);
             } break;
         }
+
+        render->step = step->next;
     }
 
-    // The format string ended but bracketText isnt empty so the last bracket was never closed
-    if(parser->sb_brack->count != 0) {
-        tffn_sb_clear(parser->sb_err);
-        tffn_sb_append_nterm(
-            parser->sb_err, "INVALID FORMAT: you forgot to close a bracket"
-        );
+    return TFFN_RENDER_DONE;
+}
+
+
+// Starts rendering the given format like tffn_parser_render_n does, but asynchronous actions
+// (see tffn_parser_define_async_action) can make the render stop and wait for them
+// Returns NULL and sets the error of the parser if the format is invalid, otherwise returns
+// a render that is either already done or waiting for an action, see tffn_async_status
+// A waiting render continues with tffn_async_resume (from an event loop callback for example),
+// tffn_async_token tells which action continuation it waits for
+// values are not copied so they must stay alive until the render is done
+// The compiled format stays pinned until tffn_async_free gets called, so updating static
+// actions in the meantime is safe (the render keeps using the old values), but every render
+// must be freed before its parser is
+TFFNAsyncRender* tffn_parser_render_async(TFFNParser* parser, const char* format, size_t format_len,
+        const TFFNValue* values, size_t value_count) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_len == 0);
+
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, format, format_len);
+    if(tmpl == NULL) return NULL;
+
+    if(tmpl->slot_count > value_count) {
+        __tffn_parser_set_error(parser, TFFN_ERR_MISSING_VALUES, 0, 0, 0);
+        parser->err_text = tmpl->format;
         return NULL;
     }
+    __tffn_parser_clear_error(parser);
+
+    TFFNAsyncRender* render = (TFFNAsyncRender*) TFFN_MALLOC(sizeof(TFFNAsyncRender));
+    TFFN_ASSERT(render != NULL && "Couldn't allocate memory");
+    render->parser = parser;
+    render->tmpl = tmpl;
+    render->step = tmpl->steps;
+    render->values = values;
+    render->sb = tffn_sb_new(64);
+    render->token = NULL;
+    tmpl->pin_count++;
+
+    __tffn_async_run(render);
+    return render;
+}
 
-    // Add the final static string part as a step
-    if(parser->sb_part->count > 0) {
-        char* static_str = tffn_sb_to_str(parser->sb_part);
-        __tffn_append_static_step(&steps_head, static_str);
-        tffn_sb_clear(parser->sb_part);
-    }
 
-    __tffn_htable_insert(parser->format_cache, format, (void*) steps_head);
-    return steps_head;
+// Returns whether the given render is done or still waiting for an action
+TFFNRenderStatus tffn_async_status(TFFNAsyncRender* render) {
+    TFFN_ASSERT(render != NULL);
+    return render->step == NULL ? TFFN_RENDER_DONE : TFFN_RENDER_PENDING;
 }
 
 
-// Returns the current error message of the parser as a newly allocated string
-char* tffn_parser_err_msg(TFFNParser* parser) {
-    if (parser == NULL) return NULL;
+// Calls the action that the render is waiting for again (with its token) and keeps rendering
+// until the render is done or it has to wait again, returns the new status
+TFFNRenderStatus tffn_async_resume(TFFNAsyncRender* render) {
+    TFFN_ASSERT(render != NULL);
+    return __tffn_async_run(render);
+}
 
-    return tffn_sb_to_str(parser->sb_err);
+
+// Returns the continuation token that the waiting action stored, NULL if the render is done
+void* tffn_async_token(TFFNAsyncRender* render) {
+    TFFN_ASSERT(render != NULL);
+    return render->token;
 }
 
 
-// Frees the given parser
-void tffn_parser_free(TFFNParser* parser) {
-    if(parser == NULL) return;
+// Returns the output of a finished render, it stays valid until the render is freed
+// view.str is NULL if the render is still waiting for an action
+TFFNStrView tffn_async_result(TFFNAsyncRender* render) {
+    TFFN_ASSERT(render != NULL);
 
-    // Free parser->format_cache
-    if (parser->format_cache != NULL) {
-        for (size_t i = 0; i < parser->format_cache->table_size; i++) {
-            __TFFNEntry* temp = parser->format_cache->entries[i];
-            while (temp != NULL) {
-                __TFFNEntry* next = temp->next;
-                TFFN_FREE(temp->key);
-                TFFN_FREE(temp);
-                temp = next;
-            }
-        }
+    TFFNStrView view;
+    view.str = NULL;
+    view.length = 0;
+    if(render->step != NULL) return view;
 
-        TFFN_FREE(parser->format_cache->entries);
-        TFFN_FREE(parser->format_cache);
-    }
-    
-    // Free parser->static_actions
-    if (parser->static_actions != NULL) {
-        for (size_t i = 0; i < parser->static_actions->table_size; i++) {
-            __TFFNEntry* temp = parser->static_actions->entries[i];
-            while (temp != NULL) {
-                __TFFNEntry* next = temp->next;
-                TFFN_FREE(temp->key);
-                TFFN_FREE(temp);
-                temp = next;
-            }
+    tffn_sb_reserve(render->sb, 1)[0] = '\0';
+    view.str = render->sb->buffer;
+    view.length = render->sb->count;
+    return view;
+}
+
+
+// Frees the given render and unpins its compiled format, a render can be freed while it is
+// still waiting, cancelling the work behind its token is up to the action that created it
+void tffn_async_free(TFFNAsyncRender* render) {
+    if(render == NULL) return;
+
+    __TFFNTemplate* tmpl = render->tmpl;
+    tmpl->pin_count--;
+    if(tmpl->pin_count == 0) __tffn_template_free_retired(tmpl);
+
+    tffn_sb_free(render->sb);
+    TFFN_FREE(render);
+}
+
+
+// Starts keeping the result of the given format for a consumer that renders it over and over
+// (a status line that gets redrawn every few milliseconds for example), see tffn_render_state_update
+// Returns NULL and sets the error of the parser if the format is invalid
+// The compiled format is held until tffn_render_state_free gets called and every state must be
+// freed before its parser is
+TFFNRenderState* tffn_parser_new_render_state(TFFNParser* parser, const char* format, size_t format_len) {
+    TFFN_ASSERT(parser != NULL);
+    TFFN_ASSERT(format != NULL || format_len == 0);
+
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, format, format_len);
+    if(tmpl == NULL) return NULL;
+    __tffn_parser_clear_error(parser);
+
+    TFFNRenderState* state = (TFFNRenderState*) TFFN_CALLOC(1, sizeof(TFFNRenderState));
+    TFFN_ASSERT(state != NULL && "Couldn't allocate memory");
+    state->parser = parser;
+    state->tmpl = tmpl;
+    state->sb = tffn_sb_new(64);
+    state->scratch = tffn_sb_new(64);
+    tmpl->hold_count++;
+    return state;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Records that old_length bytes at offset got replaced by new_length bytes, changes that touch
+// each other are merged into one
+static void __tffn_render_state_add_change(TFFNRenderState* state, size_t offset, size_t old_length, size_t new_length) {
+    if(state->change_count > 0) {
+        TFFNChange* last = &state->changes[state->change_count - 1];
+        if(last->offset + last->new_length == offset) {
+            last->old_length += old_length;
+            last->new_length += new_length;
+            return;
         }
+    }
 
-        TFFN_FREE(parser->static_actions->entries);
-        TFFN_FREE(parser->static_actions);
+    if(state->change_count == state->change_capacity) {
+        state->change_capacity = (state->change_capacity == 0) ? 4 : state->change_capacity * 2;
+        state->changes = (TFFNChange*) TFFN_REALLOC(state->changes, state->change_capacity * sizeof(TFFNChange));
+        TFFN_ASSERT(state->changes != NULL && "Couldn't allocate memory");
     }
+    TFFNChange* change = &state->changes[state->change_count++];
+    change->offset = offset;
+    change->old_length = old_length;
+    change->new_length = new_length;
+}
 
-    // Free parser->dynamic_actions
-    if (parser->dynamic_actions != NULL) {
-        for (size_t i = 0; i < parser->dynamic_actions->table_size; i++) {
-            __TFFNFuncEntry* temp = parser->dynamic_actions->entries[i];
-            while (temp != NULL) {
-                __TFFNFuncEntry* next = temp->next;
-                TFFN_FREE(temp->key);
-                TFFN_FREE(temp);
-                temp = next;
-            }
-        }
 
-        TFFN_FREE(parser->dynamic_actions->entries);
-        TFFN_FREE(parser->dynamic_actions);
+// Internal helper function, not meant to be used by this library's users
+// Renders every step of the format into state->scratch, remembers their lengths and makes the
+// whole result a single change
+static bool __tffn_render_state_full(TFFNRenderState* state, __TFFNTemplate* tmpl, const TFFNValue* values) {
+    size_t step_count = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) step_count++;
+    if(step_count > state->step_capacity) {
+        state->lengths = (size_t*) TFFN_REALLOC(state->lengths, step_count * sizeof(size_t));
+        TFFN_ASSERT(state->lengths != NULL && "Couldn't allocate memory");
+        state->step_capacity = step_count;
     }
 
-    tffn_sb_free(parser->sb_brack);
-    tffn_sb_free(parser->sb_part);
-    tffn_sb_free(parser->sb_res);
-    tffn_sb_free(parser->sb_err);
-    TFFN_FREE(parser);
+    tffn_sb_clear(state->scratch);
+    size_t i = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next) {
+        size_t start = state->scratch->count;
+        if(!__tffn_parser_run_step(state->parser, step, values, state->scratch)) return false;
+        state->lengths[i++] = state->scratch->count - start;
+    }
+
+    TFFNStrBuilder* old = state->sb;
+    state->sb = state->scratch;
+    state->scratch = old;
+    if(old->count > 0 || state->sb->count > 0) __tffn_render_state_add_change(state, 0, old->count, state->sb->count);
+
+    state->rendered = true;
+    state->version = tmpl->version;
+    return true;
 }
 
 
-// Returns a new TFFNParser instance
-// Freeing this instance is up to the user and can be done via tffn_parser_free function
-TFFNParser* tffn_parser_new() {
-    TFFNParser* parser = (TFFNParser*) TFFN_MALLOC(sizeof(TFFNParser));
-    TFFN_ASSERT(parser != NULL && "Couldn't allocate memory");
-    
-    // Init dynamic actions
-    {
-        const uint32_t TABLE_SIZE = 128;
-        parser->dynamic_actions = (__TFFNFuncHashTable*) TFFN_MALLOC(sizeof(__TFFNFuncHashTable));
-        TFFN_ASSERT(parser->dynamic_actions != NULL && "Couldn't allocate memory");
+// Renders the format of the state again and patches the kept result in place, only the steps
+// that can change (actions and slots) run and their outputs are compared with the last ones
+// The changed byte ranges can be read with tffn_render_state_changes afterwards, the first
+// update (and every update after the format got recompiled) changes the whole result
+// Returns false and sets the error of the parser if not enough values were given or an action
+// couldnt run, the steps that got updated before that keep their new outputs
+bool tffn_render_state_update(TFFNRenderState* state, const TFFNValue* values, size_t value_count) {
+    TFFN_ASSERT(state != NULL);
+    TFFNParser* parser = state->parser;
+    __TFFNTemplate* tmpl = __tffn_parser_refresh_template(parser, state->tmpl);
+    state->change_count = 0;
+
+    if(tmpl->slot_count > value_count) {
+        __tffn_parser_set_error(parser, TFFN_ERR_MISSING_VALUES, 0, 0, 0);
+        parser->err_text = tmpl->format;
+        return false;
+    }
 
-        parser->dynamic_actions->table_size = TABLE_SIZE;
-        parser->dynamic_actions->entries = (__TFFNFuncEntry**) TFFN_CALLOC(sizeof(__TFFNFuncEntry*), TABLE_SIZE);
-        TFFN_ASSERT(parser->dynamic_actions->entries != NULL && "Couldn't allocate memory");
+    if(!state->rendered || state->version != tmpl->version) {
+        if(!__tffn_render_state_full(state, tmpl, values)) return false;
+        __tffn_parser_clear_error(parser);
+        return true;
     }
 
-    // Init static actions
-    {
-        const uint32_t TABLE_SIZE = 128;
-        parser->static_actions = (__TFFNHashTable*) TFFN_MALLOC(sizeof(__TFFNHashTable));
-        TFFN_ASSERT(parser->static_actions != NULL && "Couldn't allocate memory");
+    TFFNStrBuilder* sb = state->sb;
+    size_t offset = 0, i = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next, i++) {
+        size_t old_length = state->lengths[i];
+        if(step->kind == __TFFN_STEP_STATIC) {
+            offset += old_length;
+            continue;
+        }
 
-        parser->static_actions->table_size = TABLE_SIZE;
-        parser->static_actions->entries = (__TFFNEntry**) TFFN_CALLOC(sizeof(__TFFNEntry*), TABLE_SIZE);
-        TFFN_ASSERT(parser->static_actions->entries != NULL && "Couldn't allocate memory");
-    }
+        tffn_sb_clear(state->scratch);
+        if(!__tffn_parser_run_step(parser, step, values, state->scratch)) return false;
 
-    // Init format cache
-    {
-        const uint32_t TABLE_SIZE = 128;
-        parser->format_cache = (__TFFNHashTable*) TFFN_MALLOC(sizeof(__TFFNHashTable));
-        TFFN_ASSERT(parser->format_cache != NULL && "Couldn't allocate memory");
+        size_t new_length = state->scratch->count;
+        if(new_length != old_length || memcmp(sb->buffer + offset, state->scratch->buffer, new_length) != 0) {
+            // Move everything after the step before copying the new output into its place
+            if(new_length > old_length) tffn_sb_reserve(sb, new_length - old_length);
+            memmove(sb->buffer + offset + new_length, sb->buffer + offset + old_length, sb->count - offset - old_length);
+            memcpy(sb->buffer + offset, state->scratch->buffer, new_length);
+            sb->count = sb->count - old_length + new_length;
 
-        parser->format_cache->table_size = TABLE_SIZE;
-        parser->format_cache->entries = (__TFFNEntry**) TFFN_CALLOC(sizeof(__TFFNEntry*), TABLE_SIZE);
-        TFFN_ASSERT(parser->format_cache->entries != NULL && "Couldn't allocate memory");
+            state->lengths[i] = new_length;
+            __tffn_render_state_add_change(state, offset, old_length, new_length);
+        }
+        offset += new_length;
     }
 
-    parser->sb_brack = tffn_sb_new(64);
-    parser->sb_part = tffn_sb_new(64);
-    parser->sb_err = tffn_sb_new(64);
-    parser->sb_res = tffn_sb_new(64);
-    return parser;
+    __tffn_parser_clear_error(parser);
+    return true;
 }
 
 
-// Returns true if no parsing error occurred during the last tffn_parser_parse function call
-bool tffn_parser_okay(TFFNParser* parser) {
-    if (parser == NULL) return false; // parser is literally fucking NULL, do you think its okay?!?
-    return parser->sb_err->count == 0; // does the err string exist?
+// Returns the byte ranges that the last tffn_render_state_update changed and stores how many there are
+// into *change_count, they are sorted and applying them in order to the previous result (replacing
+// old_length bytes at offset with the new_length bytes at the same offset of the new result) gives
+// the new result, so consumers can send these instead of the whole result
+const TFFNChange* tffn_render_state_changes(TFFNRenderState* state, size_t* change_count) {
+    TFFN_ASSERT(state != NULL && change_count != NULL);
+    *change_count = state->change_count;
+    return state->changes;
 }
 
 
-// Defines a static action to the given parser
-// act_text is the text that goes in between the brackets
-void tffn_parser_define_static_action(TFFNParser* parser, char* act_text, char* static_act) {
-    if (parser == NULL || static_act == NULL || act_text == NULL) return;
-    if (act_text[0] == '\0') return;
-    if (__tffn_parser_contains_act_text(parser, act_text)) return;
+// Returns the result of the last successful update, it stays valid until the next update or until
+// the state is freed. The result is empty if the state was never updated
+TFFNStrView tffn_render_state_result(TFFNRenderState* state) {
+    TFFN_ASSERT(state != NULL);
 
-    tffn_sb_clear(parser->sb_err);
-    __tffn_htable_insert(parser->static_actions, act_text, (void*)static_act);
+    // Terminate the result without counting the '\0' so the buffer can be patched as it is
+    tffn_sb_reserve(state->sb, 1)[0] = '\0';
+    TFFNStrView view;
+    view.str = state->sb->buffer;
+    view.length = state->sb->count;
+    return view;
 }
 
 
-// Defines a dynamic action to the given parser
-// act_text is the text that goes in between the brackets
-void tffn_parser_define_dynamic_action(TFFNParser* parser, char* act_text, void(*dynamic_act)(TFFNStrBuilder*)) {
-    if (parser == NULL || dynamic_act == NULL || act_text == NULL) return;
-    if (act_text[0] == '\0') return;
-    if (__tffn_parser_contains_act_text(parser, act_text)) return;
-    
-    tffn_sb_clear(parser->sb_err);
-    __tffn_fhtable_insert(parser->dynamic_actions, act_text, dynamic_act);
+// Frees the given render state and stops holding its compiled format
+void tffn_render_state_free(TFFNRenderState* state) {
+    if(state == NULL) return;
+
+    state->tmpl->hold_count--;
+    tffn_sb_free(state->sb);
+    tffn_sb_free(state->scratch);
+    TFFN_FREE(state->lengths);
+    TFFN_FREE(state->changes);
+    TFFN_FREE(state);
 }
 
 
-// Parses the given format using the given parser and returns the result as a newly allocated string
-// Its up to the user to free this string when it needs to be freed
-// Using this function will never invalidate 'format' strings so you can keep using the same string
-// If an error occurs during the parsing the following things will happen:
-//     - An error message will be appended to parser->sb_err, see tffn_parser_okay and 
-//           tffn_parser_err_msg functions for more information
-//     - This function will return NULL instead of a newly allocated string
-char* tffn_parser_parse(TFFNParser* parser, const char* format) {
+// Internal helper function, not meant to be used by this library's users
+static size_t __tffn_sb_bytes(const TFFNStrBuilder* sb) {
+    return (sb == NULL) ? 0 : sizeof(TFFNStrBuilder) + sb->capacity;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Returns the bytes that the given step list (and everything it owns) uses
+static size_t __tffn_steps_bytes(const __TFFNStep* steps) {
+    size_t bytes = 0;
+    for (const __TFFNStep* step = steps; step != NULL; step = step->next) {
+        bytes += sizeof(__TFFNStep);
+        if(step->args != NULL) {
+            // See __tffn_split_args, every argument is followed by its '\0'
+            bytes += step->arg_count * (sizeof(TFFNArg) + 1);
+            for (size_t i = 0; i < step->arg_count; i++) bytes += step->args[i].length;
+        }
+    }
+    return bytes;
+}
+
+
+// Returns how many bytes the given parser uses, split by component (see TFFNMemoryUsage)
+// The base of a child parser isnt counted, neither are asynchronous renders and render states
+TFFNMemoryUsage tffn_parser_memory_usage(TFFNParser* parser) {
     TFFN_ASSERT(parser != NULL);
-    TFFN_ASSERT(format != NULL);
 
-    if(format[0] == '\0') {
-        return ""; // format is empty string
+    TFFNMemoryUsage usage;
+    memset(&usage, 0, sizeof(usage));
+
+    __TFFNActionTable* tables[2] = { parser->actions, parser->adopted };
+    for (size_t t = 0; t < 2; t++) {
+        if(tables[t] == NULL) continue;
+        usage.actions += sizeof(__TFFNActionTable) + tables[t]->table_size * sizeof(__TFFNAction*);
+        for (uint32_t i = 0; i < tables[t]->table_size; i++) {
+            for (__TFFNAction* action = tables[t]->entries[i]; action != NULL; action = action->next) {
+                if(!action->in_arena) usage.actions += sizeof(__TFFNAction) + action->key_length + 1;
+                usage.actions += __tffn_sb_bytes(action->memo) + action->dependent_capacity * sizeof(__TFFNTemplate*);
+            }
+        }
+    }
+    for (__TFFNArena* arena = parser->arenas; arena != NULL; arena = arena->next) usage.actions += arena->byte_size;
+
+    if(parser->perfect_hash != NULL) usage.lookup += parser->perfect_hash->byte_size;
+    for (size_t i = 0; i < TFFN_MAX_NUMA_NODES; i++) {
+        const __TFFNPerfectHash* replica = parser->replicas[i];
+        if(replica == NULL) continue;
+        // See __tffn_perfect_replicate, the actions come right after the aligned table
+        size_t actions_offset = (replica->byte_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+        usage.lookup += actions_offset + sizeof(__TFFNAction) * replica->slot_count;
     }
 
-    void* steps_ojb = __tffn_htable_lookup(parser->format_cache, format);
-    
-    __TFFNStep* step = (__TFFNStep*) steps_ojb;
-    if(step == NULL) {
-        step = __tffn_parse_steps(parser, format);
-        if(step == NULL) return NULL; // parsing error happened
+    __TFFNHashTable* cache = parser->format_cache;
+    usage.cache_table = sizeof(__TFFNHashTable) + cache->table_size * sizeof(__TFFNEntry*);
+    for (uint32_t i = 0; i < cache->table_size; i++) {
+        for (__TFFNEntry* entry = cache->entries[i]; entry != NULL; entry = entry->next) {
+            __TFFNTemplate* tmpl = (__TFFNTemplate*) entry->object;
+            usage.cache_table += sizeof(__TFFNEntry) + sizeof(__TFFNTemplate);
+            usage.cache_keys += entry->key_length + 1;
+            if(tmpl->cold != NULL) {
+                usage.cold += sizeof(__TFFNColdText) + tmpl->cold->packed_length + __tffn_steps_bytes(tmpl->steps);
+                usage.cold_formats++;
+                continue; // cold templates are never pinned, so they dont have retired steps
+            }
+            if(tmpl->error.code == TFFN_OK) usage.hot_formats++;
+            usage.steps += __tffn_steps_bytes(tmpl->steps);
+            for (__TFFNRetiredSteps* retired = tmpl->retired; retired != NULL; retired = retired->next) {
+                usage.steps += sizeof(__TFFNRetiredSteps) + __tffn_steps_bytes(retired->steps);
+            }
+        }
     }
 
-    tffn_sb_clear(parser->sb_res);
+    __TFFNStringPool* strings = parser->strings;
+    usage.strings = sizeof(__TFFNStringPool) + strings->bucket_count * sizeof(__TFFNPooledString*);
+    for (__TFFNStringSlab* slab = strings->slabs; slab != NULL; slab = slab->next) {
+        usage.strings += __tffn_strings_align(sizeof(__TFFNStringSlab)) + slab->capacity;
+    }
 
-    while(step != NULL) {
-        if(step->static_step != NULL) {
-            tffn_sb_append_nterm(parser->sb_res, step->static_step);
+    usage.scratch = __tffn_sb_bytes(parser->sb_res) + __tffn_sb_bytes(parser->sb_part) + __tffn_sb_bytes(parser->sb_err)
+        + parser->compile_deps.capacity * sizeof(__TFFNAction*);
+#ifdef TFFN_ENABLE_THREADS
+    __TFFNWorkerPool* pool = parser->pool;
+    if(pool != NULL) {
+        usage.scratch += sizeof(__TFFNWorkerPool) + pool->thread_count * sizeof(__tffn_thread_t)
+            + pool->task_capacity * sizeof(__TFFNParallelTask);
+        for (size_t i = 0; i < pool->task_capacity; i++) usage.scratch += __tffn_sb_bytes(pool->tasks[i].sb);
+    }
+#endif
+
+    usage.total = sizeof(TFFNParser) + usage.actions + usage.lookup + usage.cache_table
+        + usage.cache_keys + usage.steps + usage.strings + usage.cold + usage.scratch;
+    return usage;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Cuts the capacity of sb down to high_water (or to its contents if they are longer)
+static void __tffn_sb_shrink(TFFNStrBuilder* sb, size_t high_water) {
+    if(sb == NULL || sb->capacity <= high_water) return;
+
+    size_t capacity = (sb->count > high_water) ? sb->count : high_water;
+    if(capacity == 0) capacity = 1; // a builder with no capacity could never grow again
+    if(capacity >= sb->capacity) return;
+
+    char* buffer = (char*) TFFN_REALLOC(sb->buffer, capacity);
+    TFFN_ASSERT(buffer != NULL && "Couldn't allocate memory");
+    sb->buffer = buffer;
+    sb->capacity = capacity;
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Points the static steps at the new place of their strings, strings of evacuated slabs are moved
+// into target by the first step that uses them
+static void __tffn_steps_relocate(__TFFNStringPool* strings, __TFFNStep* steps, __TFFNStringSlab* target) {
+    for (__TFFNStep* step = steps; step != NULL; step = step->next) {
+        if(step->kind != __TFFN_STEP_STATIC || step->static_step == NULL) continue;
+
+        __TFFNPooledString* entry = ((__TFFNPooledString*) step->static_step) - 1;
+        if(entry->slab != NULL && !entry->slab->evacuate) continue;
+
+        if(entry->slab != NULL) {
+            __TFFNPooledString* moved = __tffn_strings_bump(target, __tffn_strings_block_size(entry->length));
+            TFFN_ASSERT(moved != NULL && "Every moved string has room in the target slab");
+            memcpy(moved, entry, sizeof(__TFFNPooledString) + entry->length + 1);
+            moved->slab = target;
+            moved->size = __tffn_strings_block_size(entry->length);
+
+            // Take the place of the old string inside its bucket, the old one forwards to the new one
+            __TFFNPooledString** link = &strings->buckets[entry->hash & (strings->bucket_count - 1)];
+            while(*link != entry) link = &(*link)->next;
+            *link = moved;
+            entry->slab = NULL;
+            entry->next = moved;
+        }
+        step->static_step = (const char*) (entry->next + 1);
+    }
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Moves every string of the evacuated slabs (moving bytes of blocks in total) into a new slab
+// that fits exactly them, see __tffn_parser_compact_strings
+static void __tffn_parser_move_strings(TFFNParser* parser, size_t moving) {
+    __TFFNStringPool* strings = parser->strings;
+
+    // The target goes right behind the current slab, new strings keep going into the current one
+    // (or into a new one if the current one gets evacuated)
+    __TFFNStringSlab* target = (__TFFNStringSlab*) TFFN_MALLOC(__tffn_strings_align(sizeof(__TFFNStringSlab)) + moving);
+    TFFN_ASSERT(target != NULL && "Couldn't allocate memory");
+    target->owner = strings;
+    target->capacity = moving;
+    target->used = 0;
+    target->live_count = 0;
+    target->free_bytes = 0;
+    target->fit_hint = 0;
+    target->evacuate = false;
+    target->prev = strings->slabs;
+    target->next = strings->slabs->next;
+    if(target->next != NULL) target->next->prev = target;
+    strings->slabs->next = target;
+
+    __TFFNHashTable* cache = parser->format_cache;
+    for (uint32_t i = 0; i < cache->table_size; i++) {
+        for (__TFFNEntry* entry = cache->entries[i]; entry != NULL; entry = entry->next) {
+            __TFFNTemplate* tmpl = (__TFFNTemplate*) entry->object;
+            __tffn_steps_relocate(strings, tmpl->steps, target);
+            for (__TFFNRetiredSteps* retired = tmpl->retired; retired != NULL; retired = retired->next) {
+                __tffn_steps_relocate(strings, retired->steps, target);
+            }
         }
-        else if(step->dynamic_step != NULL) { 
-            step->dynamic_step(parser->sb_res);
+    }
+    TFFN_ASSERT(target->used == moving && "Only static steps use the strings of the pool");
+}
+
+
+// Internal helper function, not meant to be used by this library's users
+// Moves the strings of slabs that are at most half full into a single slab that fits exactly them
+// and frees the old slabs, which gives back the memory that free blocks keep when the strings
+// around them stay alive. Slabs with pinned strings stay where they are, empty ones are freed
+static void __tffn_parser_compact_strings(TFFNParser* parser) {
+    __TFFNStringPool* strings = parser->strings;
+
+    size_t moving = 0;
+    size_t evacuated = 0;
+    for (__TFFNStringSlab* slab = strings->slabs; slab != NULL; slab = slab->next) {
+        slab->evacuate = false;
+        if(slab->used - slab->free_bytes > slab->capacity / 2) continue;
+
+        bool pinned = false;
+        size_t live_bytes = 0;
+        for (size_t offset = 0; offset < slab->used && !pinned; ) {
+            __TFFNPooledString* block = __tffn_strings_block(slab, offset);
+            if(block->ref_count > 0) {
+                pinned = block->pinned;
+                live_bytes += __tffn_strings_block_size(block->length);
+            }
+            offset += block->size;
         }
-        else {
-            TFFN_ASSERT(0 && "This line should have been unreachable!");
+        if(pinned) continue;
+        slab->evacuate = true;
+        moving += live_bytes;
+        evacuated++;
+    }
+    if(evacuated == 0) return;
+
+    // Empty slabs (the current one can be empty) dont need a target, they are simply freed
+    if(moving > 0) __tffn_parser_move_strings(parser, moving);
+
+    __TFFNStringSlab* slab = strings->slabs;
+    while(slab != NULL) {
+        __TFFNStringSlab* next = slab->next;
+        if(slab->evacuate) {
+            if(slab->prev != NULL) slab->prev->next = slab->next;
+            else strings->slabs = slab->next;
+            if(slab->next != NULL) slab->next->prev = slab->prev;
+            TFFN_FREE(slab);
         }
+        slab = next;
+    }
+}
 
-        step = step->next;
+
+// Gives back memory that a long lived parser doesnt need anymore, after a single huge render for example:
+//     - every builder that the parser reuses between calls (and every memoized action output)
+//           whose capacity is bigger than high_water bytes gets cut down to high_water bytes
+//     - cached compilation failures are forgotten, they are compiled again if they are used again
+//     - the format cache buckets are cut down to what the remaining formats need
+//     - the static text of compiled formats is moved out of string pool slabs that are at most
+//           half full (updated static actions leave holes in them) into a slab that fits it
+//           exactly and the old slabs are freed
+// Compiled formats are never recompiled so async renders and render states stay valid, views of
+// static formats stay valid too since their text never moves. Other results of
+// tffn_parser_render_view are invalidated just like another render would invalidate them
+void tffn_parser_shrink(TFFNParser* parser, size_t high_water) {
+    TFFN_ASSERT(parser != NULL);
+
+    // Forget cached failures, the format of the last error is moved into sb_err if it is one of them
+    __TFFNHashTable* cache = parser->format_cache;
+    if(parser->failure_count > 0) {
+        for (size_t i = 0; i < TFFN_L0_CACHE_SIZE; i++) {
+            if(parser->l0[i].tmpl != NULL && parser->l0[i].tmpl->error.code != TFFN_OK) {
+                memset(&parser->l0[i], 0, sizeof(__TFFNL0Entry));
+            }
+        }
+
+        for (uint32_t i = 0; i < cache->table_size; i++) {
+            __TFFNEntry** link = &cache->entries[i];
+            while(*link != NULL) {
+                __TFFNEntry* entry = *link;
+                __TFFNTemplate* tmpl = (__TFFNTemplate*) entry->object;
+                if(tmpl->error.code == TFFN_OK) {
+                    link = &entry->next;
+                    continue;
+                }
+
+                if(parser->err_text == entry->key) {
+                    tffn_sb_clear(parser->sb_err);
+                    tffn_sb_append_sized(parser->sb_err, entry->key, entry->key_length);
+                    parser->err_text = parser->sb_err->buffer;
+                }
+
+                *link = entry->next;
+                cache->entry_count--;
+                TFFN_FREE(tmpl);
+                TFFN_FREE(entry->key);
+                TFFN_FREE(entry);
+            }
+        }
+        parser->failure_count = 0;
     }
 
-    char* result_str = tffn_sb_to_str(parser->sb_res);
-    tffn_sb_clear(parser->sb_res);
-    return result_str;
+    uint32_t table_size = __tffn_htable_size_for(128, cache->entry_count);
+    if(table_size < cache->table_size) __tffn_htable_rebucket(cache, table_size);
+
+    __tffn_parser_compact_strings(parser);
+
+    // Trim the builders, err_text has to follow sb_err if it lives inside of it
+    bool err_in_sb = parser->err_text == parser->sb_err->buffer;
+    __tffn_sb_shrink(parser->sb_err, high_water);
+    if(err_in_sb) parser->err_text = parser->sb_err->buffer;
+    __tffn_sb_shrink(parser->sb_res, high_water);
+    __tffn_sb_shrink(parser->sb_part, high_water);
+
+    if(parser->compile_deps.capacity * sizeof(__TFFNAction*) > high_water) {
+        TFFN_FREE(parser->compile_deps.items);
+        parser->compile_deps.items = NULL;
+        parser->compile_deps.count = 0;
+        parser->compile_deps.capacity = 0;
+    }
+
+    __TFFNActionTable* tables[2] = { parser->actions, parser->adopted };
+    for (size_t t = 0; t < 2; t++) {
+        if(tables[t] == NULL) continue;
+        for (uint32_t i = 0; i < tables[t]->table_size; i++) {
+            for (__TFFNAction* action = tables[t]->entries[i]; action != NULL; action = action->next) {
+                __tffn_sb_shrink(action->memo, high_water);
+            }
+        }
+    }
+
+#ifdef TFFN_ENABLE_THREADS
+    if(parser->pool != NULL) {
+        for (size_t i = 0; i < parser->pool->task_capacity; i++) __tffn_sb_shrink(parser->pool->tasks[i].sb, high_water);
+    }
+#endif
+}
+
+
+
+// Moves the compiled formats that werent used during the last window uses of any format of this
+// parser into the cold tier: the static text that only they use gets compressed (with a small
+// built-in LZ4 style codec) and given back to the string pool, which then moves the remaining
+// hot text out of string pool slabs that became at most half full and frees them (see
+// tffn_parser_shrink). Text given back to slabs that stay is reused by the next compiled formats
+// Cold formats are decompressed right away the next time they are used, so nothing changes for
+// the caller except the memory they take
+// Formats that are pinned by async renders or held by render states are never compressed, and
+// neither are the ones with less than TFFN_MIN_COLD_BYTES bytes of static text of their own
+// Formats whose text tffn_parser_render_view handed out stay hot too, so those views stay valid
+// Call this every now and then (from an idle timer for example), it goes over the whole format
+// cache while renders only pay for a counter. Returns how many formats got compressed
+size_t tffn_parser_compress_cold(TFFNParser* parser, uint64_t window) {
+    TFFN_ASSERT(parser != NULL);
+
+    size_t compressed = 0;
+    __TFFNHashTable* cache = parser->format_cache;
+    for (uint32_t i = 0; i < cache->table_size; i++) {
+        for (__TFFNEntry* entry = cache->entries[i]; entry != NULL; entry = entry->next) {
+            __TFFNTemplate* tmpl = (__TFFNTemplate*) entry->object;
+            if(tmpl->cold != NULL || tmpl->error.code != TFFN_OK || tmpl->stale) continue;
+            if(tmpl->pin_count > 0 || tmpl->hold_count > 0) continue;
+            if(parser->clock - tmpl->last_use < window) continue;
+            if(__tffn_template_freeze(parser, tmpl)) compressed++;
+        }
+    }
+
+    // The released text only gives memory back once it doesnt share its slabs with hot text anymore
+    if(compressed > 0) __tffn_parser_compact_strings(parser);
+    return compressed;
 }
 
 
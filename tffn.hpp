@@ -0,0 +1,448 @@
+// Copyright 2024 Oğuzhan Topaloğlu
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+tffn.hpp is an optional C++17 companion of tffn.h for formats that are known at compile time.
+
+tffn_parser_parse has to scan, hash and look up every format at runtime. When the format is a
+string literal in C++ code, TFFN_FORMAT does all of that work at compile time instead:
+    - the format is split into a fixed array of steps, static text segments get their '!'
+      escapes removed and their lengths fixed at compile time
+    - bracket and escape mistakes are compile errors (look for tffn_invalid_format_* in the
+      error message of your compiler)
+    - action names are looked up only once, the first time the format is rendered with a parser
+      (and again only if new actions get defined to that parser)
+    - rendering is an unrolled sequence of appends without any hashing or cache lookups
+
+Everything else (actions, their caching policies, error reporting) works exactly like tffn.h.
+
+Here is an example:
+---------- example file start ----------
+#define TFFN_IMPLEMENTATION
+#include "tffn.hpp"
+
+int main() {
+    TFFNParser* parser = tffn_parser_new();
+    tffn_parser_define_static_action(parser, "h", "Hello");
+
+    constexpr auto greet = TFFN_FORMAT("[h] [$0]!!");
+    TFFNValue values[] = { tffn_value_str("World", 5) };
+
+    char* str = greet.render(parser, values, 1);
+    if(!tffn_parser_okay(parser)) return -1;
+    printf("%s\n", str); // prints "Hello World!"
+
+    free(str);
+    tffn_parser_free(parser);
+}
+---------- example file end ----------
+
+Bindings are remembered per thread and per format, so rendering the same format with many
+different parsers works but rebinds every time the parser changes.
+*/
+
+
+#ifndef TFFN_HPP
+#define TFFN_HPP
+
+#include "tffn.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+
+// Creates a tffn::format from a string literal, every use of this macro is compiled separately
+#define TFFN_FORMAT(literal) ([] {                                                              \
+        struct tffn_format_source {                                                             \
+            static constexpr std::string_view get() { return std::string_view(literal); }       \
+        };                                                                                      \
+        return ::tffn::format<tffn_format_source>{};                                            \
+    }())
+
+
+// These functions are never defined on purpose, calling them while compiling a format makes
+// the compiler print their name as the reason of the error
+void tffn_invalid_format_nesting_brackets_are_prohibited();
+void tffn_invalid_format_you_forgot_to_open_a_bracket();
+void tffn_invalid_format_you_forgot_to_close_a_bracket();
+void tffn_invalid_format_bang_cant_be_used_inside_brackets();
+void tffn_invalid_format_format_cant_end_with_bang();
+
+
+namespace tffn {
+namespace detail {
+
+
+enum class step_kind { text, bracket };
+
+
+// One piece of a compiled format
+struct step {
+    step_kind kind;
+    std::size_t offset;      // text: start inside chars, bracket: start of its content inside the source
+    std::size_t length;      // text: length of the segment, bracket: length of its content
+    std::size_t name_length; // length of the content before the first ':', equals length without one
+    std::size_t arg_offset;  // index of the first argument inside args (only used if name_length != length)
+    std::size_t arg_count;
+    bool is_slot;            // content looks like "$N", used only if no action has the same name
+    std::size_t slot;
+};
+
+
+// How big the arrays of a compiled format need to be
+struct shape {
+    std::size_t steps = 0;
+    std::size_t chars = 0; // unescaped text segments and NULL terminated arguments
+    std::size_t args = 0;
+};
+
+
+struct arg_ref {
+    std::size_t offset; // start inside chars
+    std::size_t length;
+};
+
+
+template <std::size_t StepCount, std::size_t CharCount, std::size_t ArgCount>
+struct program {
+    std::array<step, StepCount> steps{};
+    std::array<char, CharCount> chars{};
+    std::array<arg_ref, ArgCount> args{};
+};
+
+
+// Same rules as the '$N' slots of tffn_parser_render
+constexpr bool parse_slot(std::string_view content, std::size_t& slot) {
+    if(content.size() < 2 || content[0] != '$') return false;
+
+    std::size_t index = 0;
+    for (std::size_t i = 1; i < content.size(); i++) {
+        char c = content[i];
+        if(c < '0' || c > '9') return false;
+        if(index > (SIZE_MAX - 9) / 10) return false; // would overflow
+        index = index * 10 + (std::size_t) (c - '0');
+    }
+
+    slot = index;
+    return true;
+}
+
+
+// Walks over the format exactly like tffn.h does and reports every text segment and bracket
+// to the visitor, syntax errors stop the compilation
+template <class Visitor>
+constexpr void scan(std::string_view format, Visitor& visitor) {
+    bool in_brack = false;
+    std::size_t brack_start = 0;
+
+    std::size_t i = 0;
+    while(i < format.size()) {
+        switch (format[i]) {
+            case '[': {
+                if(in_brack) tffn_invalid_format_nesting_brackets_are_prohibited();
+                in_brack = true;
+                brack_start = i + 1;
+            } break;
+
+            case ']': {
+                if(!in_brack) tffn_invalid_format_you_forgot_to_open_a_bracket();
+                in_brack = false;
+                visitor.bracket(brack_start, format.substr(brack_start, i - brack_start));
+            } break;
+
+            case '!': {
+                if(in_brack) tffn_invalid_format_bang_cant_be_used_inside_brackets();
+                if(i == format.size() - 1) tffn_invalid_format_format_cant_end_with_bang();
+                i++;
+                visitor.text(format[i]);
+            } break;
+
+            default: {
+                if(!in_brack) visitor.text(format[i]);
+            } break;
+        }
+
+        i++;
+    }
+
+    if(in_brack) tffn_invalid_format_you_forgot_to_close_a_bracket();
+    visitor.end();
+}
+
+
+// First pass, only counts how much space the compiled format needs
+struct measurer {
+    shape result;
+    bool in_text = false;
+
+    constexpr void text(char) {
+        if(!in_text) result.steps++;
+        in_text = true;
+        result.chars++;
+    }
+
+    constexpr void bracket(std::size_t, std::string_view content) {
+        in_text = false;
+        result.steps++;
+
+        std::size_t colon = content.find(':');
+        if(colon == std::string_view::npos) return;
+
+        result.args++;
+        for (std::size_t i = colon + 1; i < content.size(); i++) {
+            if(content[i] == ',') result.args++;
+        }
+        result.chars += content.size() - colon; // every ',' becomes a '\0' plus one final '\0'
+    }
+
+    constexpr void end() {}
+};
+
+
+// Second pass, fills the arrays that the first pass measured
+template <class Program>
+struct builder {
+    Program result{};
+    std::size_t step_index = 0;
+    std::size_t char_index = 0;
+    std::size_t arg_index = 0;
+    bool in_text = false;
+
+    constexpr void text(char c) {
+        if(!in_text) {
+            step& st = result.steps[step_index++];
+            st.kind = step_kind::text;
+            st.offset = char_index;
+            st.length = 0;
+        }
+
+        in_text = true;
+        result.steps[step_index - 1].length++;
+        result.chars[char_index++] = c;
+    }
+
+    constexpr void bracket(std::size_t offset, std::string_view content) {
+        in_text = false;
+
+        step& st = result.steps[step_index++];
+        st.kind = step_kind::bracket;
+        st.offset = offset;
+        st.length = content.size();
+        st.name_length = content.size();
+        st.arg_offset = arg_index;
+        st.arg_count = 0;
+        st.slot = 0;
+        st.is_slot = parse_slot(content, st.slot);
+
+        // Arguments are split the same way __tffn_split_args does it, but at compile time
+        std::size_t colon = content.find(':');
+        if(colon == std::string_view::npos) return;
+
+        st.name_length = colon;
+        std::size_t arg_start = char_index;
+        for (std::size_t i = colon + 1; i <= content.size(); i++) {
+            if(i == content.size() || content[i] == ',') {
+                result.args[arg_index++] = arg_ref{ arg_start, char_index - arg_start };
+                result.chars[char_index++] = '\0';
+                arg_start = char_index;
+                st.arg_count++;
+            }
+            else {
+                result.chars[char_index++] = content[i];
+            }
+        }
+    }
+
+    constexpr void end() {}
+};
+
+
+constexpr shape measure(std::string_view format) {
+    measurer visitor;
+    scan(format, visitor);
+    return visitor.result;
+}
+
+
+template <class Program>
+constexpr Program build(std::string_view format) {
+    builder<Program> visitor;
+    scan(format, visitor);
+    return visitor.result;
+}
+
+
+template <std::size_t ArgCount, class Program>
+constexpr std::array<TFFNArg, ArgCount> make_args(const Program& prog) {
+    std::array<TFFNArg, ArgCount> args{};
+    for (std::size_t i = 0; i < ArgCount; i++) {
+        args[i].str = prog.chars.data() + prog.args[i].offset;
+        args[i].length = prog.args[i].length;
+    }
+    return args;
+}
+
+
+inline void set_error(TFFNParser* parser, TFFNErrorCode code, std::size_t offset, std::size_t span_offset,
+        std::size_t span_length, const char* err_text) {
+    parser->err.code = code;
+    parser->err.offset = offset;
+    parser->err.span_offset = span_offset;
+    parser->err.span_length = span_length;
+    parser->err_text = err_text;
+}
+
+
+} // namespace detail
+
+
+// A format that got compiled at compile time, use TFFN_FORMAT to create one
+// Source::get() returns the format as a std::string_view
+template <class Source>
+class format {
+    static constexpr std::string_view source = Source::get();
+    static constexpr detail::shape size = detail::measure(source);
+
+    using program_type = detail::program<size.steps, size.chars, size.args>;
+    static constexpr program_type prog = detail::build<program_type>(source);
+    static constexpr std::array<TFFNArg, size.args> args = detail::make_args<size.args>(prog);
+
+    // What every bracket resolved to the last time this format got bound to a parser
+    struct binding {
+        uint64_t parser_id = 0;  // ids are never reused, unlike the addresses of freed parsers
+        uint64_t action_generation = 0;
+        bool okay = false;
+        std::size_t slot_count = 0;
+        std::array<__TFFNAction*, size.steps> actions{}; // NULL for slots and text segments
+        std::array<std::size_t, size.steps> arg_counts{};
+    };
+
+    static inline thread_local binding bound;
+
+    // Resolves every bracket with the same rules as tffn.h: full name, then the name before
+    // the first ':' (with arguments), then "$N" slots
+    static bool bind(TFFNParser* parser) {
+        bound.parser_id = parser->id;
+        bound.action_generation = parser->action_generation;
+        bound.okay = false;
+        bound.slot_count = 0;
+
+        for (std::size_t i = 0; i < size.steps; i++) {
+            const detail::step& st = prog.steps[i];
+            bound.actions[i] = nullptr;
+            bound.arg_counts[i] = 0;
+            if(st.kind != detail::step_kind::bracket) continue;
+
+            const char* content = source.data() + st.offset;
+            __TFFNAction* action = tffn_parser_find_action(parser, content, st.length);
+
+            if(action == NULL && st.name_length != st.length) {
+                action = tffn_parser_find_action(parser, content, st.name_length);
+                if(action != NULL && action->kind != __TFFN_ACTION_PARAM) {
+                    detail::set_error(parser, TFFN_ERR_UNEXPECTED_ARGS, st.offset - 1, st.offset,
+                        st.name_length, source.data());
+                    return false;
+                }
+                bound.arg_counts[i] = st.arg_count;
+            }
+
+            if(action == NULL && !st.is_slot) {
+                detail::set_error(parser, TFFN_ERR_UNDEFINED_ACTION, st.offset - 1, st.offset,
+                    st.length, source.data());
+                return false;
+            }
+
+            bound.actions[i] = action;
+            if(action == NULL && st.slot >= bound.slot_count) bound.slot_count = st.slot + 1;
+        }
+
+        bound.okay = true;
+        return true;
+    }
+
+    // Returns false if an asynchronous action couldnt finish, the error of the parser is set then
+    template <std::size_t I>
+    static bool render_step(TFFNParser* parser, TFFNStrBuilder* sb, const TFFNValue* values) {
+        constexpr detail::step st = prog.steps[I];
+
+        if constexpr (st.kind == detail::step_kind::text) {
+            tffn_sb_append_sized(sb, prog.chars.data() + st.offset, st.length);
+        }
+        else if(bound.actions[I] != nullptr) {
+            const TFFNArg* step_args = bound.arg_counts[I] != 0 ? args.data() + st.arg_offset : nullptr;
+            std::size_t start = sb->count;
+            if(!tffn_parser_run_action(parser, bound.actions[I], step_args, bound.arg_counts[I], sb)) return false;
+            tffn_sb_escape_tail(sb, start, bound.actions[I]->escape);
+        }
+        else {
+            tffn_sb_append_value(sb, &values[st.slot]);
+        }
+        return true;
+    }
+
+    template <std::size_t... I>
+    static bool render_steps(TFFNParser* parser, TFFNStrBuilder* sb, const TFFNValue* values,
+            std::index_sequence<I...>) {
+        (void) parser; (void) sb; (void) values; // formats without any steps dont use them
+        return (render_step<I>(parser, sb, values) && ...);
+    }
+
+public:
+    static constexpr std::size_t step_count = size.steps;
+
+    // Appends the result into sb, returns false and sets the error of the parser if an action
+    // doesnt exist, not enough values were given or an asynchronous action couldnt finish
+    // (nothing gets appended in that case)
+    bool render_into(TFFNParser* parser, TFFNStrBuilder* sb, const TFFNValue* values = nullptr,
+            std::size_t value_count = 0) const {
+        TFFN_ASSERT(parser != NULL && sb != NULL);
+
+        bool rebind = bound.parser_id != parser->id || bound.action_generation != parser->action_generation;
+        if((rebind || !bound.okay) && !bind(parser)) return false;
+
+        if(bound.slot_count > value_count) {
+            detail::set_error(parser, TFFN_ERR_MISSING_VALUES, 0, 0, 0, source.data());
+            return false;
+        }
+
+        std::size_t start = sb->count;
+        if(!render_steps(parser, sb, values, std::make_index_sequence<size.steps>{})) {
+            sb->count = start;
+            return false;
+        }
+        detail::set_error(parser, TFFN_OK, 0, 0, 0, NULL);
+        return true;
+    }
+
+    // Works just like tffn_parser_render, returns a newly allocated string or NULL if an error happened
+    char* render(TFFNParser* parser, const TFFNValue* values = nullptr, std::size_t value_count = 0) const {
+        TFFN_ASSERT(parser != NULL);
+
+        tffn_sb_clear(parser->sb_res);
+        if(!render_into(parser, parser->sb_res, values, value_count)) return NULL;
+
+        char* result_str = tffn_sb_to_str(parser->sb_res);
+        tffn_sb_clear(parser->sb_res);
+        return result_str;
+    }
+};
+
+
+} // namespace tffn
+
+#endif // TFFN_HPP
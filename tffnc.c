@@ -0,0 +1,324 @@
+// Copyright 2024 Oğuzhan Topaloğlu
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+tffnc turns a fixed set of TFFN templates into plain C code, one render function per template.
+
+Usage:
+    tffnc <manifest> <templates> <output.c> [output.h]
+
+The manifest lists the actions that templates can use, one per line:
+    static <name> <text>         the text is everything after the name, it gets folded into the code
+    dynamic <name> <c_function>  void c_function(TFFNStrBuilder*)
+    param <name> <c_function>    void c_function(TFFNStrBuilder*, const TFFNArg*, size_t)
+
+The templates file lists the templates, one per line:
+    <function_suffix> <format>
+
+Empty lines and lines starting with '#' are skipped in both files.
+
+Every template "x" becomes "void tffnc_render_x(TFFNStrBuilder* sb, const TFFNValue* values)".
+Templates are compiled by the same code that tffn_parser_parse uses, so static actions are
+already folded into static text, arguments are already split and "[$N]" slots read values[N].
+The generated functions dont hash, look up or cache anything, they only reserve the exact
+amount of static bytes they append and then append or call. Dynamic actions are always called
+directly, so caching policies (TFFN_ACTION_PURE, TFFN_ACTION_EPOCH) dont apply to them.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TFFN_IMPLEMENTATION
+#include "tffn.h"
+
+
+// One action of the manifest
+typedef struct _TFFNCAction {
+    char* name;
+    char* c_function; // NULL for static actions
+    char* static_text; // NULL for dynamic and parameterized actions
+    bool is_param;
+} TFFNCAction;
+
+// One template of the templates file
+typedef struct _TFFNCTemplate {
+    char* suffix;
+    char* format;
+    size_t line;
+} TFFNCTemplate;
+
+
+// Never called, they are only there so actions can be defined to the parser
+static void tffnc_dynamic_placeholder(TFFNStrBuilder* sb) { (void) sb; }
+static void tffnc_param_placeholder(TFFNStrBuilder* sb, const TFFNArg* args, size_t arg_count) {
+    (void) sb; (void) args; (void) arg_count;
+}
+
+
+static void tffnc_fail(const char* file, size_t line, const char* message) {
+    fprintf(stderr, "tffnc: %s:%zu: %s\n", file, line, message);
+    exit(1);
+}
+
+
+// Reads the next line of file into sb without its line ending, returns false at the end of file
+static bool tffnc_read_line(FILE* file, TFFNStrBuilder* sb) {
+    tffn_sb_clear(sb);
+
+    int c = fgetc(file);
+    if(c == EOF) return false;
+
+    while(c != EOF && c != '\n') {
+        if(c != '\r') tffn_sb_append_char(sb, (char) c);
+        c = fgetc(file);
+    }
+    return true;
+}
+
+
+// Splits "first rest of the line" at the first space, returns false if there is no rest
+static bool tffnc_split(char* line, char** first, char** rest) {
+    char* space = strchr(line, ' ');
+    if(space == NULL) return false;
+
+    *space = '\0';
+    *first = line;
+    *rest = space + 1;
+    return true;
+}
+
+
+static char* tffnc_copy(const char* str) {
+    size_t length = strlen(str);
+    char* copy = (char*) malloc(length + 1);
+    memcpy(copy, str, length + 1);
+    return copy;
+}
+
+
+// Returns the lines of the given file that arent empty or comments, line_numbers[i] is set too
+static char** tffnc_read_lines(const char* path, size_t* count, size_t** line_numbers) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) tffnc_fail(path, 0, "couldnt open the file");
+
+    size_t capacity = 16;
+    char** lines = (char**) malloc(capacity * sizeof(char*));
+    *line_numbers = (size_t*) malloc(capacity * sizeof(size_t));
+    *count = 0;
+
+    TFFNStrBuilder* sb = tffn_sb_new(256);
+    size_t line_number = 0;
+    while(tffnc_read_line(file, sb)) {
+        line_number++;
+        if(sb->count == 0 || sb->buffer[0] == '#') continue;
+
+        if(*count == capacity) {
+            capacity *= 2;
+            lines = (char**) realloc(lines, capacity * sizeof(char*));
+            *line_numbers = (size_t*) realloc(*line_numbers, capacity * sizeof(size_t));
+        }
+        lines[*count] = tffn_sb_to_str(sb);
+        (*line_numbers)[*count] = line_number;
+        (*count)++;
+    }
+
+    tffn_sb_free(sb);
+    fclose(file);
+    return lines;
+}
+
+
+// Writes str as a C string literal, every byte that isnt plain ASCII is written as an octal
+// escape so the literal means the same thing no matter what comes after it
+static void tffnc_write_literal(FILE* out, const char* str, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char) str[i];
+        if(c == '"' || c == '\\' || c == '?') fprintf(out, "\\%c", c);
+        else if(c >= 32 && c < 127) fputc(c, out);
+        else fprintf(out, "\\%03o", c);
+    }
+    fputc('"', out);
+}
+
+
+static const TFFNCAction* tffnc_find_action(const TFFNCAction* actions, size_t count, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if(strcmp(actions[i].name, name) == 0) return &actions[i];
+    }
+    return NULL;
+}
+
+
+// Writes the render function of a single template
+static void tffnc_write_template(FILE* out, TFFNParser* parser, const TFFNCAction* actions, size_t action_count,
+        const TFFNCTemplate* tmpl_def, const char* templates_path) {
+    __TFFNTemplate* tmpl = __tffn_parser_get_template(parser, tmpl_def->format, strlen(tmpl_def->format));
+    if(tmpl == NULL) {
+        char* err_msg = tffn_parser_err_msg(parser);
+        tffnc_fail(templates_path, tmpl_def->line, err_msg);
+    }
+
+    size_t static_bytes = 0;
+    size_t step_index = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next, step_index++) {
+        if(step->kind == __TFFN_STEP_STATIC) static_bytes += step->static_length;
+
+        // Argument arrays live right before the function that uses them
+        if(step->kind == __TFFN_STEP_DYNAMIC && step->arg_count > 0) {
+            fprintf(out, "static const TFFNArg tffnc_args_%s_%zu[] = {\n", tmpl_def->suffix, step_index);
+            for (size_t i = 0; i < step->arg_count; i++) {
+                fprintf(out, "    { ");
+                tffnc_write_literal(out, step->args[i].str, step->args[i].length);
+                fprintf(out, ", %zu },\n", step->args[i].length);
+            }
+            fprintf(out, "};\n\n");
+        }
+    }
+
+    fprintf(out, "// ");
+    tffnc_write_literal(out, tmpl_def->format, strlen(tmpl_def->format));
+    fprintf(out, "\n// values needs at least %zu elements\n", tmpl->slot_count);
+    fprintf(out, "void tffnc_render_%s(TFFNStrBuilder* sb, const TFFNValue* values) {\n", tmpl_def->suffix);
+    if(tmpl->slot_count == 0) fprintf(out, "    (void) values;\n");
+    if(static_bytes > 0) fprintf(out, "    tffn_sb_reserve(sb, %zu);\n", static_bytes);
+
+    step_index = 0;
+    for (__TFFNStep* step = tmpl->steps; step != NULL; step = step->next, step_index++) {
+        switch (step->kind) {
+            case __TFFN_STEP_STATIC: {
+                fprintf(out, "    tffn_sb_append_sized(sb, ");
+                tffnc_write_literal(out, step->static_step, step->static_length);
+                fprintf(out, ", %zu);\n", step->static_length);
+            } break;
+
+            case __TFFN_STEP_DYNAMIC: {
+                const TFFNCAction* action = tffnc_find_action(actions, action_count, step->dynamic_step->key);
+                if(!action->is_param) {
+                    fprintf(out, "    %s(sb);\n", action->c_function);
+                }
+                else if(step->arg_count == 0) {
+                    fprintf(out, "    %s(sb, NULL, 0);\n", action->c_function);
+                }
+                else {
+                    fprintf(out, "    %s(sb, tffnc_args_%s_%zu, %zu);\n",
+                        action->c_function, tmpl_def->suffix, step_index, step->arg_count);
+                }
+            } break;
+
+            case __TFFN_STEP_SLOT: {
+                fprintf(out, "    tffn_sb_append_value(sb, &values[%zu]);\n", step->slot);
+            } break;
+        }
+    }
+
+    fprintf(out, "}\n\n\n");
+}
+
+
+int main(int argc, char** argv) {
+    if(argc != 4 && argc != 5) {
+        fprintf(stderr, "Usage: tffnc <manifest> <templates> <output.c> [output.h]\n");
+        return 1;
+    }
+
+    const char* manifest_path = argv[1];
+    const char* templates_path = argv[2];
+    TFFNParser* parser = tffn_parser_new();
+
+    // Read the manifest and define every action to the parser
+    size_t action_count;
+    size_t* action_lines;
+    char** manifest = tffnc_read_lines(manifest_path, &action_count, &action_lines);
+    TFFNCAction* actions = (TFFNCAction*) calloc(action_count + 1, sizeof(TFFNCAction));
+
+    for (size_t i = 0; i < action_count; i++) {
+        char *kind, *rest, *name, *value;
+        if(!tffnc_split(manifest[i], &kind, &rest) || !tffnc_split(rest, &name, &value)) {
+            tffnc_fail(manifest_path, action_lines[i], "expected '<kind> <name> <value>'");
+        }
+
+        actions[i].name = tffnc_copy(name);
+        if(strcmp(kind, "static") == 0) {
+            actions[i].static_text = tffnc_copy(value);
+            tffn_parser_define_static_action(parser, actions[i].name, actions[i].static_text);
+        }
+        else if(strcmp(kind, "dynamic") == 0) {
+            actions[i].c_function = tffnc_copy(value);
+            tffn_parser_define_dynamic_action(parser, actions[i].name, tffnc_dynamic_placeholder);
+        }
+        else if(strcmp(kind, "param") == 0) {
+            actions[i].c_function = tffnc_copy(value);
+            actions[i].is_param = true;
+            tffn_parser_define_param_action(parser, actions[i].name, tffnc_param_placeholder);
+        }
+        else {
+            tffnc_fail(manifest_path, action_lines[i], "kind must be 'static', 'dynamic' or 'param'");
+        }
+
+        if(!tffn_parser_okay(parser)) tffnc_fail(manifest_path, action_lines[i], tffn_parser_err_msg(parser));
+    }
+
+    // Read the templates
+    size_t template_count;
+    size_t* template_lines;
+    char** template_file = tffnc_read_lines(templates_path, &template_count, &template_lines);
+    TFFNCTemplate* templates = (TFFNCTemplate*) calloc(template_count + 1, sizeof(TFFNCTemplate));
+
+    for (size_t i = 0; i < template_count; i++) {
+        if(!tffnc_split(template_file[i], &templates[i].suffix, &templates[i].format)) {
+            tffnc_fail(templates_path, template_lines[i], "expected '<function_suffix> <format>'");
+        }
+        templates[i].line = template_lines[i];
+    }
+
+    // Write the source file
+    FILE* out = fopen(argv[3], "wb");
+    if(out == NULL) tffnc_fail(argv[3], 0, "couldnt create the file");
+
+    fprintf(out, "// Generated by tffnc from '%s' and '%s', do not edit\n\n", manifest_path, templates_path);
+    fprintf(out, "#include \"tffn.h\"\n\n\n");
+
+    for (size_t i = 0; i < action_count; i++) {
+        if(actions[i].c_function == NULL) continue;
+        if(actions[i].is_param) fprintf(out, "void %s(TFFNStrBuilder*, const TFFNArg*, size_t);\n", actions[i].c_function);
+        else fprintf(out, "void %s(TFFNStrBuilder*);\n", actions[i].c_function);
+    }
+    fprintf(out, "\n\n");
+
+    for (size_t i = 0; i < template_count; i++) {
+        tffnc_write_template(out, parser, actions, action_count, &templates[i], templates_path);
+    }
+    fclose(out);
+
+    // Write the header file
+    if(argc == 5) {
+        out = fopen(argv[4], "wb");
+        if(out == NULL) tffnc_fail(argv[4], 0, "couldnt create the file");
+
+        fprintf(out, "// Generated by tffnc from '%s' and '%s', do not edit\n\n", manifest_path, templates_path);
+        fprintf(out, "#ifndef TFFNC_GENERATED_H\n#define TFFNC_GENERATED_H\n\n#include \"tffn.h\"\n\n");
+        for (size_t i = 0; i < template_count; i++) {
+            fprintf(out, "void tffnc_render_%s(TFFNStrBuilder* sb, const TFFNValue* values);\n", templates[i].suffix);
+        }
+        fprintf(out, "\n#endif // TFFNC_GENERATED_H\n");
+        fclose(out);
+    }
+
+    tffn_parser_free(parser);
+    return 0;
+}